@@ -20,10 +20,12 @@
 #include "dialogcopy.h"
 #include "ui_dialogcopy.h"
 #include <QFileDialog>
+#include <QPushButton>
 
 DialogCopy::DialogCopy(QWidget *parent) :
     QDialog(parent),
-    ui(new Ui::DialogCopy)
+    ui(new Ui::DialogCopy),
+    exporting(false)
 {
     ui->setupUi(this);
     connect(ui->radioButtonCopyFile, SIGNAL(toggled(bool)), this, SLOT(copyToFileToggled(bool)));
@@ -38,17 +40,27 @@ DialogCopy::~DialogCopy()
 void DialogCopy::showEvent(QShowEvent *e)
 {
     ui->label_error->hide();
+    ui->progressBar_export->hide();
     QWidget::showEvent(e);
 }
 
+void DialogCopy::showError(const QString& error)
+{
+    ui->label_error->setText(error);
+    ui->label_error->show();
+}
+
+// The dialog is hidden when the export finishes
 void DialogCopy::accept()
 {
+    if (exporting)
+        return;
     ui->label_error->hide();
     if (ui->radioButtonCopyFile->isChecked())
     {
         QString str = ui->lineEditCopyFileName->text();
         if (str.isEmpty()) {
-            ui->label_error->show();
+            showError(tr("Invalid file name. Please enter a valid filename."));
             return;
         }
         QFile f(ui->lineEditCopyFileName->text());
@@ -56,7 +68,7 @@ void DialogCopy::accept()
             if (f.open(QIODevice::WriteOnly)) {
                 f.close();
             } else {
-                ui->label_error->show();
+                showError(tr("Invalid file name. Please enter a valid filename."));
                 return;
             }
         }
@@ -64,7 +76,49 @@ void DialogCopy::accept()
     } else {
         emit copyDialogAccepted(QString());
     }
-    hide();;
+}
+
+void DialogCopy::reject()
+{
+    if (exporting) {
+        emit exportCancelled();
+        return;
+    }
+    QDialog::reject();
+}
+
+void DialogCopy::exportStarted(int messages)
+{
+    exporting = true;
+    ui->groupBoxCopyWhere->setEnabled(false);
+    ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
+    ui->progressBar_export->setRange(0, messages);
+    ui->progressBar_export->setValue(0);
+    ui->progressBar_export->setFormat(tr("%v of %m messages"));
+    ui->progressBar_export->show();
+}
+
+void DialogCopy::exportProgress(int messages, qint64 bytes, double messagesPerSec, double bytesPerSec)
+{
+    ui->progressBar_export->setValue(messages);
+    ui->progressBar_export->setFormat(tr("%v of %m messages, %1 KB (%2 msgs/s, %3 MB/s)")
+                                      .arg(bytes / 1024)
+                                      .arg(messagesPerSec, 0, 'f', 1)
+                                      .arg(bytesPerSec / (1024 * 1024), 0, 'f', 2));
+}
+
+// A failed export leaves the dialog up with the reason. A cancelled one
+// has no error and closes like a finished one.
+void DialogCopy::exportFinished(const QString& error)
+{
+    exporting = false;
+    ui->groupBoxCopyWhere->setEnabled(true);
+    ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(true);
+    ui->progressBar_export->hide();
+    if (error.isEmpty())
+        hide();
+    else
+        showError(error);
 }
 
 void DialogCopy::copyToFileToggled(bool checked)
@@ -75,8 +129,10 @@ void DialogCopy::copyToFileToggled(bool checked)
 
 void DialogCopy::browse()
  {
+     // a .qvsnap file is written as a binary snapshot
      QString file = QFileDialog::getSaveFileName ( this,
-                        tr("Save to file"), QDir::currentPath());
+                        tr("Save to file"), QDir::currentPath(),
+                        tr("XML export (*.xml);;Binary snapshot (*.qvsnap);;All files (*)"));
 
      if (!file.isEmpty()) {
         ui->lineEditCopyFileName->setText(file);
@@ -34,17 +34,27 @@ public:
     explicit DialogCopy(QWidget *parent = 0);
     ~DialogCopy();
 
+    // an accepted export reports through these. The dialog stays open
+    // until it finishes, and Cancel stops it instead of closing.
+    void exportStarted(int messages);
+    void exportFinished(const QString& error);
+
 public slots:
+    void exportProgress(int messages, qint64 bytes, double messagesPerSec, double bytesPerSec);
     void accept();
+    void reject();
     void browse();
     void copyToFileToggled(bool);
 
 signals:
     void copyDialogAccepted(const QString&);
+    void exportCancelled();
 
 private:
     Ui::DialogCopy *ui;
+    bool exporting;
     void showEvent(QShowEvent *);
+    void showError(const QString&);
 };
 
 #endif // DIALOGCOPY_H
@@ -20,6 +20,8 @@
 #include "dialogopen.h"
 #include "ui_dialogopen.h"
 #include <QSettings>
+#include "prefix-matcher.h"
+#include "model-queue.h"
 
 DialogOpen::DialogOpen(QWidget *parent) :
     QDialog(parent),
@@ -35,8 +37,49 @@ DialogOpen::~DialogOpen()
     delete ui;
 }
 
+uint DialogOpen::headerWindow() const
+{
+    return (uint)ui->spinBox_headerWindow->value();
+}
+
+uint DialogOpen::minimumRefresh() const
+{
+    return (uint)ui->spinBox_minimumRefresh->value();
+}
+
+uint DialogOpen::headerCache() const
+{
+    return (uint)ui->spinBox_headerCache->value();
+}
+
+uint DialogOpen::topQueues() const
+{
+    return (uint)ui->spinBox_topQueues->value();
+}
+
+QStringList DialogOpen::systemQueues() const
+{
+    return PrefixMatcher::parse(ui->lineEdit_systemQueues->text());
+}
+
+QStringList DialogOpen::includedQueues() const
+{
+    return PrefixMatcher::parse(ui->lineEdit_includeQueues->text());
+}
+
+QStringList DialogOpen::excludedQueues() const
+{
+    return PrefixMatcher::parse(ui->lineEdit_excludeQueues->text());
+}
+
 void DialogOpen::accept()
 {
+    emit headerWindowChanged(headerWindow());
+    emit minimumRefreshChanged(minimumRefresh());
+    emit headerCacheChanged(headerCache());
+    emit topQueuesChanged(topQueues());
+    emit systemQueuesChanged(systemQueues());
+    emit queueFiltersChanged(includedQueues(), excludedQueues());
     emit dialogOpenAccepted(ui->lineEdit_url->text(),
                             ui->lineEdit_connect->text(),
                             ui->lineEdit_qmf->text());
@@ -51,6 +94,13 @@ void DialogOpen::saveSettings() {
     settings.setValue("url",     ui->lineEdit_url->text());
     settings.setValue("connect", ui->lineEdit_connect->text());
     settings.setValue("qmf",     ui->lineEdit_qmf->text());
+    settings.setValue("headerWindow", ui->spinBox_headerWindow->value());
+    settings.setValue("minimumRefresh", ui->spinBox_minimumRefresh->value());
+    settings.setValue("headerCache", ui->spinBox_headerCache->value());
+    settings.setValue("topQueues", ui->spinBox_topQueues->value());
+    settings.setValue("systemQueues", ui->lineEdit_systemQueues->text());
+    settings.setValue("includeQueues", ui->lineEdit_includeQueues->text());
+    settings.setValue("excludeQueues", ui->lineEdit_excludeQueues->text());
     settings.endGroup();
 
 }
@@ -62,5 +112,13 @@ void DialogOpen::restoreSettings() {
     ui->lineEdit_url->setText(QString(settings.value("url").toString()));
     ui->lineEdit_connect->setText(QString(settings.value("connect").toString()));
     ui->lineEdit_qmf->setText(QString(settings.value("qmf", "{strict-security:False}").toString()));
+    ui->spinBox_headerWindow->setValue(settings.value("headerWindow", 100).toInt());
+    ui->spinBox_minimumRefresh->setValue(settings.value("minimumRefresh", 1000).toInt());
+    ui->spinBox_headerCache->setValue(settings.value("headerCache", 10000).toInt());
+    ui->spinBox_topQueues->setValue(settings.value("topQueues", 50).toInt());
+    ui->lineEdit_systemQueues->setText(settings.value("systemQueues",
+                                       QueueTableModel::defaultSystemQueuePrefixes().join(", ")).toString());
+    ui->lineEdit_includeQueues->setText(settings.value("includeQueues").toString());
+    ui->lineEdit_excludeQueues->setText(settings.value("excludeQueues").toString());
     settings.endGroup();
 }
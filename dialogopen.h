@@ -21,6 +21,7 @@
 #define DIALOGOPEN_H
 
 #include <QDialog>
+#include <QStringList>
 
 namespace Ui {
     class DialogOpen;
@@ -34,11 +35,25 @@ public:
     explicit DialogOpen(QWidget *parent = 0);
     ~DialogOpen();
 
+    uint headerWindow() const;
+    uint minimumRefresh() const;
+    uint headerCache() const;
+    uint topQueues() const;
+    QStringList systemQueues() const;
+    QStringList includedQueues() const;
+    QStringList excludedQueues() const;
+
 public slots:
     void accept();
 
 signals:
     void dialogOpenAccepted(const QString&, const QString&, const QString&);
+    void headerWindowChanged(uint);
+    void minimumRefreshChanged(uint);
+    void headerCacheChanged(uint);
+    void topQueuesChanged(uint);
+    void systemQueuesChanged(const QStringList&);
+    void queueFiltersChanged(const QStringList&, const QStringList&);
 
 private:
     Ui::DialogOpen *ui;
@@ -0,0 +1,206 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "export-job.h"
+#include "qmf-thread.h"
+#include "queue-exporter.h"
+#include "snapshot-writer.h"
+#include <QFile>
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <boost/scoped_ptr.hpp>
+
+// Progress is reported at most this often, in msecs
+static const qint64 PROGRESS_INTERVAL = 250;
+
+ExportJob::ExportJob(uint id, QmfThread* _qmf, const QString& _file, const qmf::DataAddr& _queue,
+                     const std::vector<ExportMessage>& _messages, QObject* parent) :
+    QThread(parent), jobId(id), qmf(_qmf), file(_file), queueAddr(_queue), messages(_messages),
+    total(_messages.size()), queueArrived(false), cancelled(false), failedSequence(-1)
+{
+}
+
+bool ExportJob::isCancelled() const
+{
+    QMutexLocker locker(&lock);
+    return cancelled;
+}
+
+QString ExportJob::errorString() const
+{
+    QMutexLocker locker(&lock);
+    return errorText;
+}
+
+void ExportJob::setError(const QString& error)
+{
+    QMutexLocker locker(&lock);
+    errorText = error;
+}
+
+QString ExportJob::text() const
+{
+    return QString::fromUtf8(output.constData(), output.size());
+}
+
+void ExportJob::cancel()
+{
+    QMutexLocker locker(&lock);
+    cancelled = true;
+    cond.wakeOne();
+}
+
+void ExportJob::gotQueue(uint job, const qmf::Data& data)
+{
+    if (job != jobId)
+        return;
+    QMutexLocker locker(&lock);
+    queue = data;
+    queueArrived = true;
+    cond.wakeOne();
+}
+
+// Bodies for other jobs, or that come in after this one stopped, are dropped
+void ExportJob::gotBody(uint job, int sequence, const qmf::ConsoleEvent& event)
+{
+    if (job != jobId)
+        return;
+    QMutexLocker locker(&lock);
+    if (cancelled)
+        return;
+    arrived.insert(sequence, event);
+    cond.wakeOne();
+}
+
+// Only the first failure is kept, the export stops there
+void ExportJob::callFailed(uint job, int sequence, const QString& error)
+{
+    if (job != jobId)
+        return;
+    QMutexLocker locker(&lock);
+    if (!failure.isEmpty())
+        return;
+    failure = error.isEmpty() ? tr("The call failed") : error;
+    failedSequence = sequence;
+    cond.wakeOne();
+}
+
+void ExportJob::run()
+{
+    QFile f;
+    QBuffer buffer(&output);
+    QIODevice* out;
+    if (file.isEmpty()) {
+        buffer.open(QIODevice::WriteOnly);
+        out = &buffer;
+    } else {
+        f.setFileName(file);
+        if (!f.open(QIODevice::WriteOnly)) {
+            setError(f.errorString());
+            return;
+        }
+        out = &f;
+    }
+
+    {
+        std::vector<qpid::types::Variant::Map> args;
+        args.reserve(messages.size());
+        for (std::vector<ExportMessage>::const_iterator iter = messages.begin(); iter != messages.end(); iter++)
+            args.push_back(iter->args);
+        qmf->startExport(jobId, queueAddr, args);
+    }
+
+    // files named as snapshots get the binary format, the rest XML
+    boost::scoped_ptr<QueueExporter> exporter;
+    if (SnapshotWriter::isSnapshotFile(file))
+        exporter.reset(new SnapshotWriter(out));
+    else
+        exporter.reset(new QueueExporter(out));
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 reported = 0;
+    bool stopped = false;
+
+    // the queue's properties go first
+    {
+        QMutexLocker locker(&lock);
+        while (!cancelled && failure.isEmpty() && !queueArrived)
+            cond.wait(&lock);
+        stopped = cancelled || !failure.isEmpty();
+    }
+    if (!stopped)
+        exporter->beginQueue(queue);
+
+    for (int next = 0; !stopped && next < total && exporter->isOk(); next++) {
+        qmf::ConsoleEvent response;
+        {
+            QMutexLocker locker(&lock);
+            while (!cancelled && failure.isEmpty() && !arrived.contains(next))
+                cond.wait(&lock);
+            if (cancelled || !failure.isEmpty()) {
+                stopped = true;
+                break;
+            }
+            response = arrived.take(next);
+        }
+
+        ExportMessage& message(messages[next]);
+        QString body;
+        const qpid::types::Variant::Map& results(response.getArguments());
+        qpid::types::Variant::Map::const_iterator iter = results.find("body");
+        if (iter != results.end())
+            body = QueueExporter::decodeBody(iter->second, QueueExporter::contentType(message.header));
+        exporter->writeMessage(message.messageId, message.header, body);
+        // the message isn't needed any more
+        message = ExportMessage();
+
+        qint64 now = clock.elapsed();
+        if (now - reported >= PROGRESS_INTERVAL || next + 1 == total) {
+            reported = now;
+            double secs = now > 0 ? now / 1000.0 : 0.001;
+            emit progress(next + 1, exporter->bytesWritten(), (next + 1) / secs, exporter->bytesWritten() / secs);
+        }
+    }
+
+    if (!stopped)
+        exporter->endQueue();
+    // nothing reaches the job from the QMF thread after this, so it can
+    // be deleted once it has finished
+    qmf->cancelExport(jobId);
+
+    if (!exporter->isOk()) {
+        setError(exporter->errorString());
+    } else if (stopped) {
+        // a cancel is not an error
+        QMutexLocker locker(&lock);
+        if (!cancelled && failedSequence >= 0)
+            errorText = tr("Message %1 could not be exported: %2")
+                            .arg(messages[failedSequence].messageId.c_str()).arg(failure);
+        else if (!cancelled && !failure.isEmpty())
+            errorText = tr("The export failed: %1").arg(failure);
+    }
+
+    // don't leave a partial export behind
+    if (!file.isEmpty() && (stopped || !exporter->isOk())) {
+        f.close();
+        f.remove();
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef _qe_export_job_h
+#define _qe_export_job_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QHash>
+#include <QByteArray>
+#include <qmf/Data.h>
+#include <qmf/DataAddr.h>
+#include <qmf/ConsoleEvent.h>
+#include <qpid/types/Variant.h>
+#include <string>
+#include <vector>
+
+class QmfThread;
+
+// One message to export: its id, its queueGetMessageHeader response and
+// the arguments of the call that gets its body
+struct ExportMessage {
+    std::string messageId;
+    qmf::ConsoleEvent header;
+    qpid::types::Variant::Map args;
+
+    ExportMessage() {}
+    ExportMessage(const std::string& _m, const qmf::ConsoleEvent& _h, const qpid::types::Variant::Map& _a) :
+        messageId(_m), header(_h), args(_a) {}
+};
+
+//
+// Exports a queue on its own thread. The queue's properties and the
+// bodies are asked for all at once, and the QMF thread keeps a bounded
+// number of the calls outstanding. The responses come back in any order
+// on the QMF thread;
+// they are held until their turn and written in sequence order. Only
+// bodies that arrived ahead of the next one to write are held.
+//
+class ExportJob : public QThread {
+    Q_OBJECT
+
+public:
+    // an empty file exports to text() instead
+    ExportJob(uint id, QmfThread* qmf, const QString& file, const qmf::DataAddr& queue,
+              const std::vector<ExportMessage>& messages, QObject* parent = 0);
+
+    uint id() const { return jobId; }
+    int messageCount() const { return total; }
+    bool isClipboard() const { return file.isEmpty(); }
+    bool isCancelled() const;
+    // empty unless the export failed
+    QString errorString() const;
+    // the export, once finished, when there is no file
+    QString text() const;
+
+public slots:
+    void cancel();
+    // called on the QMF thread
+    void gotQueue(uint job, const qmf::Data&);
+    void gotBody(uint job, int sequence, const qmf::ConsoleEvent&);
+    void callFailed(uint job, int sequence, const QString& error);
+
+signals:
+    void progress(int messages, qint64 bytes, double messagesPerSec, double bytesPerSec);
+
+protected:
+    void run();
+
+private:
+    uint        jobId;
+    QmfThread*  qmf;
+    QString     file;
+    qmf::DataAddr queueAddr;
+    std::vector<ExportMessage> messages;
+    int         total;
+    QByteArray  output;
+
+    // guarded by lock
+    mutable QMutex lock;
+    QWaitCondition cond;
+    qmf::Data   queue;
+    bool        queueArrived;
+    QHash<int, qmf::ConsoleEvent> arrived;
+    bool        cancelled;
+    QString     failure;        // why a call failed, the export stops
+    int         failedSequence;
+    QString     errorText;
+
+    void setError(const QString&);
+};
+
+#endif
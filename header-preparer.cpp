@@ -0,0 +1,146 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "header-preparer.h"
+#include "qmf-thread.h"
+
+// These properties are displayed at the top level of the tree
+static const char* summaryProperties[] = { "UserId", "ContentLength", "ContentType", "MessageId", 0 };
+// These properties are displayed on the last line of the header details
+static const char* bodyProperties[] = { "ContentLength", "ContentType", "ContentEncoding", 0 };
+
+static bool listed(const char** names, const std::string& name)
+{
+    for (; *names; names++)
+        if (name == *names)
+            return true;
+    return false;
+}
+
+// Format a header property value for display
+static QString formatValue(const qpid::types::Variant& var)
+{
+    switch (var.getType()) {
+    case qpid::types::VAR_UINT8:
+    case qpid::types::VAR_UINT16:
+    case qpid::types::VAR_UINT32:
+    case qpid::types::VAR_UINT64:
+    case qpid::types::VAR_INT8:
+    case qpid::types::VAR_INT16:
+    case qpid::types::VAR_INT32:
+    case qpid::types::VAR_INT64:
+        return QString::number((qulonglong)var.asUint64());
+    case qpid::types::VAR_FLOAT:
+    case qpid::types::VAR_DOUBLE:
+        return QString::number((double)var.asDouble());
+
+    case qpid::types::VAR_STRING:
+    case qpid::types::VAR_BOOL:
+    case qpid::types::VAR_UUID:
+    case qpid::types::VAR_VOID:
+        return "\"" + QString(var.asString().c_str()) + "\"";
+    case qpid::types::VAR_MAP:
+        return QString("<map/>");
+    case qpid::types::VAR_LIST:
+        return QString("<list/>");
+    }
+    return QString(var.asString().c_str());
+}
+
+QString headerText(const HeaderFields& fields, bool withNames)
+{
+    QString text;
+    QString sep;
+    for (HeaderFields::const_iterator iter = fields.constBegin(); iter != fields.constEnd(); ++iter) {
+        text += sep;
+        if (withNames && !iter.key().isEmpty()) {
+            text += iter.key();
+            text += "=";
+            sep = ", ";
+        }
+        text += iter.value();
+    }
+    return text;
+}
+
+// Convert each header in a queueGetMessageHeader response
+void PreparedHeader::prepare(const qmf::ConsoleEvent& event, const qpid::types::Variant::Map& callArgs,
+                             std::vector<PreparedHeader>& out)
+{
+    // get the messageId and queue that were passed to the qmf call
+    std::string messageId;
+    std::string queue;
+    qpid::types::Variant::Map::const_iterator iter = callArgs.find("id");
+    if (iter != callArgs.end())
+        messageId = iter->second.asString();
+    iter = callArgs.find("name");
+    if (iter != callArgs.end())
+        queue = iter->second.asString();
+
+    // get the arguments returned in the call results
+    const qpid::types::Variant::Map& args(event.getArguments());
+    for (iter = args.begin(); iter != args.end(); iter++) {
+        out.push_back(PreparedHeader());
+        PreparedHeader& header(out.back());
+        header.queue = QString(queue.c_str());
+        header.messageId = messageId;
+        header.id = QString(messageId.c_str()).toUInt();
+        header.event = event;
+        header.args = callArgs;
+        header.summary[""] = QString(messageId.c_str());
+
+        const qpid::types::Variant::Map& attrs((iter->second).asMap());
+        for (qpid::types::Variant::Map::const_iterator attr = attrs.begin();
+             attr != attrs.end(); attr++) {
+
+            header.addField(attr->first, formatValue(attr->second));
+        }
+        header.summaryText = headerText(header.summary, true);
+    }
+}
+
+void PreparedHeader::addField(const std::string& name, const QString& value)
+{
+    QString key(name.c_str());
+
+    // add the property to either the body node or a detail node
+    if (listed(bodyProperties, name))
+        body[key] = value;
+    else
+        details[key] = value;
+
+    // also add the property to the summary node if appropriate
+    if (listed(summaryProperties, name))
+        summary[key] = value;
+}
+
+HeaderPreparer::HeaderPreparer(QmfThread* _t, ResponseList& _r) : thread(_t)
+{
+    responses.swap(_r);
+}
+
+void HeaderPreparer::run()
+{
+    std::vector<PreparedHeader>* batch = new std::vector<PreparedHeader>();
+    batch->reserve(responses.size());
+    for (ResponseList::const_iterator iter = responses.begin(); iter != responses.end(); iter++)
+        PreparedHeader::prepare(iter->first, iter->second, *batch);
+    thread->headersPrepared(PreparedHeaderBatch(batch));
+}
@@ -0,0 +1,86 @@
+#ifndef _qe_header_preparer_h
+#define _qe_header_preparer_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <QRunnable>
+#include <QMap>
+#include <QString>
+#include <QMetaType>
+#include <qmf/ConsoleEvent.h>
+#include <qpid/types/Variant.h>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include <string>
+#include <utility>
+
+class QmfThread;
+
+// property name -> display value
+typedef QMap<QString, QString> HeaderFields;
+
+//
+// One message header converted for display. Built off the GUI thread so
+// the header tree only has to splice it in.
+//
+struct PreparedHeader {
+    QString         queue;
+    std::string     messageId;
+    quint32         id;
+    HeaderFields    summary;        // shown on the top level row
+    QString         summaryText;
+    HeaderFields    details;        // one child row each
+    HeaderFields    body;           // shown on the body row
+
+    // kept for fetching the body and for export
+    qmf::ConsoleEvent           event;
+    qpid::types::Variant::Map   args;
+
+    static void prepare(const qmf::ConsoleEvent&, const qpid::types::Variant::Map& callArgs,
+                        std::vector<PreparedHeader>& out);
+
+    // put a header property on the rows it is shown on
+    void addField(const std::string& name, const QString& value);
+};
+
+typedef boost::shared_ptr<const std::vector<PreparedHeader> > PreparedHeaderBatch;
+Q_DECLARE_METATYPE(PreparedHeaderBatch);
+
+// Joins the fields into the text of a row
+QString headerText(const HeaderFields&, bool withNames);
+
+//
+// Prepares a batch of queueGetMessageHeader responses on a worker thread
+// and hands the result back to the QMF thread to be signalled.
+//
+class HeaderPreparer : public QRunnable {
+public:
+    typedef std::vector<std::pair<qmf::ConsoleEvent, qpid::types::Variant::Map> > ResponseList;
+
+    // takes the contents of responses
+    HeaderPreparer(QmfThread*, ResponseList& responses);
+    void run();
+
+private:
+    QmfThread*      thread;
+    ResponseList    responses;
+};
+
+#endif
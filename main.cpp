@@ -18,12 +18,12 @@
  */
 
 #include "main.h"
+#include "queue-exporter.h"
 #include <iostream>
 #include <QSettings>
 #include <qmf/DataAddr.h>
 #include <qmf/ConsoleEvent.h>
 #include <qmf/Query.h>
-#include <qpid/messaging/Message.h>
 
 
 QView::QView(QMainWindow* parent) : QMainWindow(parent)
@@ -46,7 +46,9 @@ QView::QView(QMainWindow* parent) : QMainWindow(parent)
     //
     qRegisterMetaType<qpid::types::Variant::Map>();
     qRegisterMetaType<qmf::ConsoleEvent>();
-    qRegisterMetaType<qmf::Data>();
+    qRegisterMetaType<QList<quint32> >("QList<quint32>");
+    qRegisterMetaType<PreparedHeaderBatch>("PreparedHeaderBatch");
+    qRegisterMetaType<QueueSampleBatch>("QueueSampleBatch");
 
     //
     // Add UI widgets not defined in explorer_main.ui form
@@ -79,16 +81,19 @@ QView::QView(QMainWindow* parent) : QMainWindow(parent)
     queueModel = new QueueTableModel(this);
 
     //
-    // Create a proxy model to enable sorting by column
-    queueProxyModel = new QSortFilterProxyModel(this);
-    queueProxyModel->setSourceModel(queueModel);
-    queueProxyModel->setFilterKeyColumn(0);
-    queueProxyModel->setDynamicSortFilter(true);
+    // Create a proxy model to enable sorting by column and filtering by name
+    queueProxyModel = new QueueProxyModel(queueModel, this);
 
     //
     // Assign the proxy model to the view
     tableView_object->setModel(queueProxyModel);
+    // depths and rates show their recent trend
+    tableView_object->setItemDelegate(new SparklineDelegate(tableView_object));
+    // the header's sort indicator has to agree with the proxy's order
+    tableView_object->sortByColumn(0, Qt::AscendingOrder);
     tableView_object->horizontalHeader()->setMovable(true);
+    tableView_object->horizontalHeader()->setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(tableView_object->horizontalHeader(), SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(queueColumnCtxMenu(QPoint)));
 
     // this is the internal object that controls the queue table selection
     itemSelector = tableView_object->selectionModel();
@@ -110,12 +115,24 @@ QView::QView(QMainWindow* parent) : QMainWindow(parent)
     //
     openDialog = new DialogOpen(this);
     connect(openDialog, SIGNAL(dialogOpenAccepted(QString,QString,QString)), qmf, SLOT(connect_url(QString,QString,QString)));
+    connect(openDialog, SIGNAL(headerWindowChanged(uint)), qmf, SLOT(setHeaderWindow(uint)));
+    connect(openDialog, SIGNAL(minimumRefreshChanged(uint)), qmf, SLOT(setMinimumRefresh(uint)));
+    qmf->setHeaderWindow(openDialog->headerWindow());
+    qmf->setMinimumRefresh(openDialog->minimumRefresh());
+    connect(openDialog, SIGNAL(headerCacheChanged(uint)), headerModel, SLOT(setCacheLimit(uint)));
+    headerModel->setCacheLimit(openDialog->headerCache());
+    connect(openDialog, SIGNAL(systemQueuesChanged(QStringList)), queueModel, SLOT(setSystemQueuePrefixes(QStringList)));
+    queueModel->setSystemQueuePrefixes(openDialog->systemQueues());
+    connect(openDialog, SIGNAL(queueFiltersChanged(QStringList,QStringList)), qmf, SLOT(setQueueFilters(QStringList,QStringList)));
+    qmf->setQueueFilters(openDialog->includedQueues(), openDialog->excludedQueues());
 
     purgeDialog = new DialogPurge(this);
     connect(purgeDialog, SIGNAL(purgeDialogAccepted(uint)), this, SLOT(queuePurge(uint)));
 
     copyDialog = new DialogCopy(this);
     connect(copyDialog, SIGNAL(copyDialogAccepted(QString)), this, SLOT(queueCopy(QString)));
+    exportJob = 0;
+    exportJobs = 0;
 
     //
     // Linkage for the menu and the Connection Status label.
@@ -132,31 +149,64 @@ QView::QView(QMainWindow* parent) : QMainWindow(parent)
     connect(messageToolBar, SIGNAL(visibilityChanged(bool)), this, SLOT(toggleMessageToolbar(bool)));
     connect(queueToolBar, SIGNAL(visibilityChanged(bool)), this, SLOT(toggleQueueToolbar(bool)));
 
-    connect(qmf, SIGNAL(addQueue(qmf::Data,uint)), queueModel, SLOT(addQueue(qmf::Data,uint)));
-    connect(qmf, SIGNAL(doneAddingQueues(uint)), this, SLOT(doneAddingQueues(uint)));
-    connect(qmf, SIGNAL(gotMessageHeaders(qmf::ConsoleEvent, qpid::types::Variant::Map)), this, SLOT(gotHeader(qmf::ConsoleEvent,qpid::types::Variant::Map)));
+    connectLiveQueues(true);
+
+    // The recorder is called straight from the qmf thread and writes on its own
+    recorder = new StatsRecorder(this);
+    connect(qmf, SIGNAL(addQueues(QueueSampleBatch,uint)), recorder, SLOT(queuesListed(QueueSampleBatch,uint)), Qt::DirectConnection);
+    connect(qmf, SIGNAL(updateQueues(QueueSampleBatch)), recorder, SLOT(queuesUpdated(QueueSampleBatch)), Qt::DirectConnection);
+    connect(qmf, SIGNAL(doneAddingQueues(uint)), recorder, SLOT(queueListDone(uint)), Qt::DirectConnection);
+    connect(actionRecordStatistics, SIGNAL(toggled(bool)), this, SLOT(toggleRecording(bool)));
+
+    // Scrub through a recording instead of showing the broker's queues
+    playbackCorrelator = 0;
+    playbackSecond = 0;
+    connect(actionPlayRecording, SIGNAL(toggled(bool)), this, SLOT(togglePlayback(bool)));
+    connect(playbackSlider, SIGNAL(valueChanged(int)), this, SLOT(playbackMoved(int)));
+    // Browse an exported queue instead of the broker's
+    connect(actionOpenExport, SIGNAL(toggled(bool)), this, SLOT(toggleOfflineQueue(bool)));
+    connect(qmf, SIGNAL(gotMessageHeaders(PreparedHeaderBatch)), this, SLOT(gotHeaders(PreparedHeaderBatch)));
     connect(qmf, SIGNAL(removedMessage(qmf::ConsoleEvent, qpid::types::Variant::Map)), this, SLOT(messageRemoved(qmf::ConsoleEvent,qpid::types::Variant::Map)));
-    connect(qmf, SIGNAL(doneRequestingHeaders(quint32)), headerModel, SLOT(expire(quint32)));
-    connect(qmf, SIGNAL(requestedMessageHeaders(quint32,quint32)), headerModel, SLOT(updating(quint32,quint32)));
+    connect(qmf, SIGNAL(removedMessageHeaders(QString,QList<quint32>)), this, SLOT(headersRemoved(QString,QList<quint32>)));
+    connect(qmf, SIGNAL(addedMessageIds(QString,QList<quint32>)), this, SLOT(messageIdsAdded(QString,QList<quint32>)));
+    connect(headerModel, SIGNAL(headersWanted(QList<quint32>)), this, SLOT(headersWanted(QList<quint32>)));
 
 
     connect(actionRefresh, SIGNAL(toggled(bool)), qmf, SLOT(pauseRefreshes(bool)));
     connect(actionRefresh, SIGNAL(toggled(bool)), this, SLOT(on_actionRefresh_toggled(bool)));
 
-    // update the list of messages each time the list of queues are updated
-    connect(queueModel, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(getHeaderIds()));
-
     // Show/Hide the system queues
     connect(actionShowManagementQueues, SIGNAL(toggled(bool)), queueModel, SLOT(toggleSystemQueues(bool)));
     queueModel->toggleSystemQueues(actionShowManagementQueues->isChecked());
 
+    // Fetch all the headers of the selected queue, or only those being shown
+    connect(actionWindowedHeaders, SIGNAL(toggled(bool)), this, SLOT(toggleWindowedHeaders(bool)));
+    actionWindowedHeaders->setChecked(settings.value("windowedHeaders", false).toBool());
+
+    // Show all the queues, or only the deepest, largest or busiest ones
+    QActionGroup* queuesShown = new QActionGroup(this);
+    queuesShown->addAction(actionAllQueues)->setData(QueueTableModel::TOP_OFF);
+    queuesShown->addAction(actionDeepestQueues)->setData(QueueTableModel::TOP_MSG_DEPTH);
+    queuesShown->addAction(actionLargestQueues)->setData(QueueTableModel::TOP_BYTE_DEPTH);
+    queuesShown->addAction(actionBusiestQueues)->setData(QueueTableModel::TOP_ENQUEUE_RATE);
+    connect(queuesShown, SIGNAL(triggered(QAction*)), this, SLOT(showTopQueues(QAction*)));
+    connect(openDialog, SIGNAL(topQueuesChanged(uint)), queueModel, SLOT(setTopQueueCount(uint)));
+    int topMode = settings.value("queuesShown", QueueTableModel::TOP_OFF).toInt();
+    QList<QAction*> modes = queuesShown->actions();
+    for (int idx=0; idx<modes.size(); idx++) {
+        if (modes[idx]->data().toInt() == topMode) {
+            modes[idx]->setChecked(true);
+            showTopQueues(modes[idx]);
+        }
+    }
+
     // Show the last qmf exception
     connect(qmf, SIGNAL(qmfError(QString)), this, SLOT(qmfException(QString)));
 
     // Show the message body when we click on a NODE_BODY row in the header tree
     connect(treeView_objects, SIGNAL(expanded(QModelIndex)), headerModel, SLOT(selected(QModelIndex)));
 
-    connect(headerModel, SIGNAL(bodySelected(QModelIndex, qmf::ConsoleEvent,qpid::types::Variant::Map)), qmf, SLOT(showBody(QModelIndex,qmf::ConsoleEvent,qpid::types::Variant::Map)));
+    connect(headerModel, SIGNAL(bodySelected(QModelIndex, qmf::ConsoleEvent,qpid::types::Variant::Map)), this, SLOT(bodyWanted(QModelIndex,qmf::ConsoleEvent,qpid::types::Variant::Map)));
     connect(qmf, SIGNAL(gotMessageBody(qmf::ConsoleEvent,qpid::types::Variant::Map,QModelIndex)), this, SLOT(gotBody(qmf::ConsoleEvent,qpid::types::Variant::Map,QModelIndex)));
     //connect(headerModel, SIGNAL(summarySelected(QModelIndex)), treeView_objects, SLOT(expand(QModelIndex)));
 
@@ -227,6 +277,16 @@ void QView::createToolBars()
     messageToolBar->setEnabled(false);
     messageToolBar->setToolButtonStyle(Qt::ToolButtonTextUnderIcon);
 
+    // only shown while a recording is played back
+    playbackToolBar = new QToolBar(tr("Playback"));
+    addToolBar(Qt::BottomToolBarArea, playbackToolBar);
+    playbackToolBar->setObjectName("Playback");
+    playbackSlider = new QSlider(Qt::Horizontal);
+    playbackToolBar->addWidget(playbackSlider);
+    playbackTime = new QLabel;
+    playbackToolBar->addWidget(playbackTime);
+    playbackToolBar->hide();
+
     connect(actionPurge, SIGNAL(triggered()), this, SLOT(showPurge()));
     connect(actionCopy_Messages, SIGNAL(triggered()), this, SLOT(showCopy()));
 }
@@ -257,8 +317,33 @@ void QView::headerCtxMenu(const QPoint& pos)
     headerPopupMenu->exec(treeView_objects->mapToGlobal(pos));
 }
 
+// Let the user choose which queue properties are shown as columns
+void QView::queueColumnCtxMenu(const QPoint& pos)
+{
+    QMenu menu;
+    for (int idx=0; idx<QueueTableModel::columnDescriptorCount(); idx++) {
+        QAction* action = menu.addAction(QueueTableModel::columnDescriptor(idx).header);
+        action->setCheckable(true);
+        action->setChecked(queueModel->isColumnVisible(idx));
+        action->setData(idx);
+        // the name column is always shown
+        if (idx == 0)
+            action->setEnabled(false);
+    }
+
+    QAction* chosen = menu.exec(tableView_object->horizontalHeader()->mapToGlobal(pos));
+    if (chosen) {
+        queueModel->setColumnVisible(chosen->data().toInt(), chosen->isChecked());
+        // hiding the sort column makes the proxy sort by name
+        tableView_object->horizontalHeader()->setSortIndicator(queueProxyModel->sortColumn(),
+                                                               queueProxyModel->sortOrder());
+    }
+}
+
 void QView::messageDelete()
 {
+    if (offline.isOpen() || player.isOpen())
+        return;
     // get the name of the current queue
     if (tableView_object->hasSelected()) {
         QString name = tableView_object->selectedQueueName(queueModel, queueProxyModel);
@@ -281,8 +366,7 @@ void QView::messageRemoved(const qmf::ConsoleEvent& event, const qpid::types::Va
     // request the new list of headers
     qpid::types::Variant::Map::const_iterator iter = callArgs.find("name");
     if (iter != callArgs.end()) {
-        headerModel->clear();
-
+        // the removed message is dropped from the tree by the refresh
         name = iter->second.asString().c_str();
         qmf->getQueueHeaders(name);
     }
@@ -323,8 +407,24 @@ void QView::queueSelected() {
     // clear out the header data from the tree view
     headerModel->clear();
 
-    // call the broker to get the list of headers for the selected queue
-    getHeaderIds();
+    // the exported queue's messages all get a row, their headers are
+    // read as the rows are shown
+    if (offline.isOpen()) {
+        if (tableView_object->hasSelected())
+            headerModel->addMessageIds(offline.messageIds());
+        return;
+    }
+    // a recording has no messages
+    if (player.isOpen())
+        return;
+
+    // have the qmf thread get, and keep refreshing, the list of headers
+    // for the selected queue
+    if (tableView_object->hasSelected()) {
+        QString name = tableView_object->selectedQueueName(queueModel, queueProxyModel);
+        const qmf::DataAddr& dataAddr = tableView_object->selectedQueueDataAddr(queueModel, queueProxyModel);
+        qmf->watchQueue(name, dataAddr);
+    }
 }
 
 // a batch of queues was just added
@@ -335,11 +435,8 @@ void QView::doneAddingQueues(uint correlator)
         tableView_object->selectRow(0);
         // and adjust the size of the name column
         tableView_object->resizeColumnToContents(0);
-        queueProxyModel->sort(0);
     }
 
-    // put any newly added queues in the correct order in the display
-    queueProxyModel->sort(queueProxyModel->sortColumn(), queueProxyModel->sortOrder());
 /*
     // If the selected queue has messages, enable the export action
     QVariant depth = tableView_object->selectedQueueDepth(queueModel, queueProxyModel);
@@ -353,37 +450,236 @@ void QView::doneAddingQueues(uint correlator)
     queueModel->refresh(correlator);
 }
 
-// SLOT: called when a queue is highlighted (mouse or keyboard)
-// Asks qmf to get the message headers for the selected queue
-void QView::getHeaderIds()
+// SLOT: called when a batch of headers is received via qmf
+// Make sure the queue that requested the headers is still the current queue
+void QView::gotHeaders(const PreparedHeaderBatch& batch)
 {
-    if (tableView_object->hasSelected()) {
-        QString name = tableView_object->selectedQueueName(queueModel, queueProxyModel);
-        qmf->getQueueHeaders(name);
+    if (offline.isOpen() || player.isOpen())
+        return;
+    headerModel->addHeaders(batch, tableView_object->selectedQueueName(queueModel, queueProxyModel));
+}
+
+// SLOT: called when messages have left a queue
+// Drop them from the tree if it is still showing that queue
+void QView::headersRemoved(const QString& name, const QList<quint32>& ids)
+{
+    if (offline.isOpen() || player.isOpen())
+        return;
+    if (name == tableView_object->selectedQueueName(queueModel, queueProxyModel))
+        headerModel->removeHeaders(ids);
+}
+
+// Windowed mode: new messages are on the selected queue
+void QView::messageIdsAdded(const QString& name, const QList<quint32>& ids)
+{
+    if (offline.isOpen() || player.isOpen())
+        return;
+    if (name == tableView_object->selectedQueueName(queueModel, queueProxyModel))
+        headerModel->addMessageIds(ids);
+}
+
+// Windowed mode: the header tree is showing rows whose headers aren't loaded
+void QView::headersWanted(const QList<quint32>& ids)
+{
+    if (offline.isOpen()) {
+        headerModel->addHeaders(offline.headers(ids), offline.queueName());
+        return;
     }
+    if (tableView_object->hasSelected())
+        qmf->fetchHeaders(tableView_object->selectedQueueName(queueModel, queueProxyModel), ids);
 }
 
-// SLOT: called when a batch of headers is received via qmf
-// Make sure the queue that requested the headers is still the current queue
-void QView::gotHeader(const qmf::ConsoleEvent& event, const qpid::types::Variant::Map& map)
+void QView::toggleWindowedHeaders(bool on)
 {
-    // get the name of the queue that requested the headers
-    const qpid::types::Variant::Map::const_iterator iter = map.find("name");
-    if (iter != map.end()) {
-        // get the name of the currently selected queue
-        QString name = tableView_object->selectedQueueName(queueModel, queueProxyModel);
-        if (name.toStdString() == iter->second.asString()) {
-            // go ahead and add the headers
-            headerModel->addHeader(event, map);
-        }
+    QSettings settings;
+    settings.setValue("windowedHeaders", on);
+
+    // an exported queue is always shown windowed
+    if (offline.isOpen())
+        return;
+
+    // every row must be the same height, or the view asks for all of them
+    treeView_objects->setUniformRowHeights(on);
+    headerModel->setWindowed(on);
+    qmf->setWindowedHeaders(on);
+
+    // start over with the selected queue
+    if (tableView_object->hasSelected())
+        queueSelected();
+}
+
+// Feed the queue table from the broker, or stop so a recording can be shown
+void QView::connectLiveQueues(bool live)
+{
+    if (live) {
+        connect(qmf, SIGNAL(addQueues(QueueSampleBatch,uint)), queueModel, SLOT(addQueues(QueueSampleBatch,uint)));
+        connect(qmf, SIGNAL(updateQueues(QueueSampleBatch)), queueModel, SLOT(updateQueues(QueueSampleBatch)));
+        connect(qmf, SIGNAL(doneAddingQueues(uint)), this, SLOT(doneAddingQueues(uint)));
+    } else {
+        disconnect(qmf, SIGNAL(addQueues(QueueSampleBatch,uint)), queueModel, SLOT(addQueues(QueueSampleBatch,uint)));
+        disconnect(qmf, SIGNAL(updateQueues(QueueSampleBatch)), queueModel, SLOT(updateQueues(QueueSampleBatch)));
+        disconnect(qmf, SIGNAL(doneAddingQueues(uint)), this, SLOT(doneAddingQueues(uint)));
+    }
+}
+
+// Purge, copy and delete act on the broker, not on a recording or an export
+void QView::enableBrokerActions()
+{
+    bool live = !player.isOpen() && !offline.isOpen();
+    actionPurge->setEnabled(live);
+    actionCopy_Messages->setEnabled(live);
+    actionDelete->setEnabled(live);
+}
+
+void QView::toggleRecording(bool on)
+{
+    if (!on) {
+        recorder->stop();
+        return;
+    }
+    if (recorder->isRecording())
+        return;
+
+    QString path = QFileDialog::getSaveFileName(this, tr("Record statistics"), QString(),
+                                                tr("Statistics recordings (*.qvr)"));
+    if (path.isEmpty()) {
+        actionRecordStatistics->setChecked(false);
+        return;
+    }
+    if (!recorder->record(path)) {
+        QMessageBox::warning(this, tr("Record statistics"), recorder->errorString());
+        actionRecordStatistics->setChecked(false);
+    }
+}
+
+// While a recording is played back the live queue updates are ignored.
+// The queue table starts over either way.
+void QView::togglePlayback(bool on)
+{
+    if (!on) {
+        if (!player.isOpen())
+            return;
+        player.close();
+        playbackToolBar->hide();
+        queueModel->clear();
+        connectLiveQueues(true);
+        enableBrokerActions();
+        return;
+    }
+    if (player.isOpen())
+        return;
+    actionOpenExport->setChecked(false);
+
+    QString path = QFileDialog::getOpenFileName(this, tr("Play recording"), QString(),
+                                                tr("Statistics recordings (*.qvr)"));
+    if (path.isEmpty()) {
+        actionPlayRecording->setChecked(false);
+        return;
+    }
+    if (!player.open(path)) {
+        QMessageBox::warning(this, tr("Play recording"), player.errorString());
+        actionPlayRecording->setChecked(false);
+        return;
+    }
+
+    connectLiveQueues(false);
+    queueModel->clear();
+    headerModel->clear();
+    enableBrokerActions();
+    playbackSlider->setRange(0, (player.endTime() - player.startTime()) / 1000);
+    playbackSlider->setValue(0);
+    playbackSecond = 0;
+    playbackToolBar->show();
+    playbackMoved(0);
+}
+
+// Show the queues as they were the given number of seconds into the recording
+void QView::playbackMoved(int seconds)
+{
+    if (!player.isOpen())
+        return;
+
+    qint64 time = player.startTime() + (qint64)seconds * 1000;
+    playbackTime->setText(QDateTime::fromMSecsSinceEpoch(time).toString("yyyy-MM-dd hh:mm:ss"));
+
+    // the queue histories only run forwards
+    if (seconds < playbackSecond)
+        queueModel->clear();
+    playbackSecond = seconds;
+
+    ++playbackCorrelator;
+    queueModel->addQueues(player.queuesAt(time), playbackCorrelator);
+    queueModel->refresh(playbackCorrelator);
+}
+
+// Show an exported queue, with no broker needed. The header tree is put
+// in windowed mode so the headers are only read from the file as their
+// rows are shown.
+void QView::toggleOfflineQueue(bool on)
+{
+    if (!on) {
+        if (!offline.isOpen())
+            return;
+        offline.close();
+        queueModel->clear();
+        headerModel->clear();
+        treeView_objects->setUniformRowHeights(actionWindowedHeaders->isChecked());
+        headerModel->setWindowed(actionWindowedHeaders->isChecked());
+        connectLiveQueues(true);
+        enableBrokerActions();
+        return;
+    }
+    if (offline.isOpen())
+        return;
+    actionPlayRecording->setChecked(false);
+
+    QString path = QFileDialog::getOpenFileName(this, tr("Open export"), QString(),
+                                                tr("Queue exports (*.xml *.qvsnap);;All files (*)"));
+    if (path.isEmpty()) {
+        actionOpenExport->setChecked(false);
+        return;
     }
+    if (!offline.open(path)) {
+        QMessageBox::warning(this, tr("Open export"), offline.errorString());
+        actionOpenExport->setChecked(false);
+        return;
+    }
+
+    connectLiveQueues(false);
+    queueModel->clear();
+    headerModel->clear();
+    treeView_objects->setUniformRowHeights(true);
+    headerModel->setWindowed(true);
+    enableBrokerActions();
+
+    ++playbackCorrelator;
+    queueModel->addQueues(offline.queues(), playbackCorrelator);
+    queueModel->refresh(playbackCorrelator);
+    tableView_object->selectRow(0);
+}
+
+// SLOT: A body row was expanded. Read it from the export, or ask the broker.
+void QView::bodyWanted(const QModelIndex& index, const qmf::ConsoleEvent& event, const qpid::types::Variant::Map& args)
+{
+    if (offline.isOpen())
+        headerModel->setBodyText(index, offline.body(args));
+    else
+        qmf->showBody(index, event, args);
+}
+
+void QView::showTopQueues(QAction* action)
+{
+    QSettings settings;
+    int mode = action->data().toInt();
+    settings.setValue("queuesShown", mode);
+
+    queueModel->setTopQueues((QueueTableModel::TopMode)mode, openDialog->topQueues());
 }
 
 // The text in the filter edit box was changed
 void QView::on_lineEdit_queue_filter_textChanged(QString filter)
 {
-    queueProxyModel->setFilterRegExp(QRegExp(filter, Qt::CaseInsensitive,
-                                        QRegExp::FixedString));
+    queueProxyModel->setFilterFixedString(filter);
 }
 
 // SLOT: Show the about dialog box
@@ -395,6 +691,8 @@ void QView::showAbout() {
 // SLOT: Show the purge dialog box
 void QView::showPurge()
 {
+    if (offline.isOpen() || player.isOpen())
+        return;
     QString name = tableView_object->selectedQueueName(queueModel, queueProxyModel);
     if (!name.isEmpty()) {
         purgeDialog->setQueueName(name);
@@ -405,6 +703,16 @@ void QView::showPurge()
 // SLOT: Show the copy dialog box
 void QView::showCopy()
 {
+    // exports come from the broker
+    if (offline.isOpen() || player.isOpen())
+        return;
+    // an export needs every header, windowed mode only has a few
+    if (headerModel->isWindowed()) {
+        QMessageBox::information(this, tr("Export"),
+                                 tr("Exporting is not available while the headers are windowed. "
+                                    "Turn off View > Load message headers on demand to export the queue."));
+        return;
+    }
     QString name = tableView_object->selectedQueueName(queueModel, queueProxyModel);
     if (!name.isEmpty()) {
         //copyDialog->setQueueName(name);
@@ -424,146 +732,70 @@ void QView::gotBody(const qmf::ConsoleEvent &event, const qpid::types::Variant::
     const qpid::types::Variant::Map& results(event.getArguments());
     iter = results.find("body");
     if (iter != results.end()) {
-        body = decodeBody(iter->second, contentType);
+        body = QueueExporter::decodeBody(iter->second, contentType);
         headerModel->setBodyText(index, body);
     }
 }
 
-QString QView::decodeBody(const qpid::types::Variant& var, const std::string& contentType)
-{
-    QString body;
-    if (contentType == "amqp/map") {
-
-        qpid::messaging::Message message;
-        message.setContent(var.asString());
-        message.setContentType(contentType);
-
-        qpid::types::Variant::Map bodyMap;
-        qpid::messaging::decode(message, bodyMap);
-
-        std::stringstream bodyStream;
-        bodyStream << bodyMap;
-        body = QString(bodyStream.str().c_str());
-    } else if (contentType == "amqp/list") {
-        body = QString("TODO: decode the list");
-    } else {
-        body = QString(var.asString().c_str());
-    }
-    return body;
-}
-
 // SLOT: The purge dialog was accepted. Send the request and update the display
 void QView::queuePurge(uint count)
 {
     if (tableView_object->hasSelected()) {
-        qmf::Agent agent = tableView_object->selectedQueueAgent(queueModel, queueProxyModel);
+        QString name = tableView_object->selectedQueueName(queueModel, queueProxyModel);
         const qmf::DataAddr& dataAddr = tableView_object->selectedQueueDataAddr(queueModel, queueProxyModel);
 
-        qpid::types::Variant::Map map;
-        map["request"] = count;
-        // syncronous call
-        agent.callMethod("purge", map, dataAddr);
-
-        // reget the queue's data
-        // clear out the header data from the tree view
-        headerModel->clear();
-        getHeaderIds();
+        // the qmf thread re-gets the queue's messages once the purge is done
+        // and the purged ones are dropped from the tree
+        qmf->queuePurge(name, dataAddr, count);
     }
 }
 
-// SLOT: The copy dialog was accepted. Copy the message headers/body
+// SLOT: The copy dialog was accepted. Export the selected queue's headers
+// and bodies to the file, or to the clipboard, in the background
 void QView::queueCopy(const QString& file)
 {
-    QString xml = exportQueue();
-    if (file.isEmpty()) {
-        QClipboard *clipboard = QApplication::clipboard();
-        clipboard->setText(xml);
-    } else {
-        QFile f(file);
-        if (f.open(QIODevice::WriteOnly)) {
-            f.write(xml.toStdString().c_str());
-            f.close();
-        }
-    }
-}
-
-QString QView::exportQueue()
-{
-    std::stringstream buff;
-    const qmf::Data& queue(tableView_object->selectedQueue(queueModel, queueProxyModel));
-    qpid::types::Variant::Map::const_iterator iter;
-    const qpid::types::Variant::Map& attrs(queue.getProperties());
-
-    // treat the queue name property as an attribute in the xml file
-    buff << "<queue";
-    iter = attrs.find("name");
-    if (iter != attrs.end()) {
-        buff << " name=\"" << iter->second.asString() << "\"";
-    }
-    buff << ">\n";
-
-    // export all the other properties
-    buff << queue;
-
-    // export all the message properties
-    QString messages = exportAllMessages();
-    buff << messages.toStdString();
-
-    buff << "</queue>\n";
-
-    return QString(buff.str().c_str());
-}
-
-QString QView::exportAllMessages()
+    if (exportJob || headerModel->isWindowed())
+        return;
+
+    // the job gets its own copy of what it needs from the headers, they
+    // may change while it runs
+    const IndexList& headers(headerModel->getMessageHeaderList());
+    std::vector<ExportMessage> messages;
+    messages.reserve(headers.size());
+    for (IndexList::const_iterator iter = headers.begin(); iter != headers.end(); iter++)
+        messages.push_back(ExportMessage((*iter)->messageId, (*iter)->event, (*iter)->args));
+
+    exportJob = new ExportJob(++exportJobs, qmf, file,
+                              tableView_object->selectedQueueDataAddr(queueModel, queueProxyModel),
+                              messages, this);
+    connect(qmf, SIGNAL(gotExportQueue(uint,qmf::Data)),
+            exportJob, SLOT(gotQueue(uint,qmf::Data)), Qt::DirectConnection);
+    connect(qmf, SIGNAL(gotExportBody(uint,int,qmf::ConsoleEvent)),
+            exportJob, SLOT(gotBody(uint,int,qmf::ConsoleEvent)), Qt::DirectConnection);
+    connect(qmf, SIGNAL(exportFailed(uint,int,QString)),
+            exportJob, SLOT(callFailed(uint,int,QString)), Qt::DirectConnection);
+    connect(copyDialog, SIGNAL(exportCancelled()), exportJob, SLOT(cancel()), Qt::DirectConnection);
+    connect(exportJob, SIGNAL(progress(int,qint64,double,double)),
+            copyDialog, SLOT(exportProgress(int,qint64,double,double)));
+    connect(exportJob, SIGNAL(finished()), this, SLOT(exportFinished()));
+
+    copyDialog->exportStarted(exportJob->messageCount());
+    exportJob->start();
+}
+
+// SLOT: The export job is done
+void QView::exportFinished()
 {
-    std::stringstream buff;
-    QString body;
-    std::string contentType;
-
-    const IndexList& messages(headerModel->getMessageHeaderList());
-    buff << " <messages>\n";
-
-    IndexList::const_iterator iter;
-    iter = messages.begin();
-    while (iter != messages.end()) {
-
-        buff << "  <message sequence=\"" << (**iter).messageId << "\">\n";
-
-        // add all the message header attributes
-        buff << **iter;
-
-        // add the body
-        qpid::types::Variant::Map::const_iterator i;
-        const qpid::types::Variant::Map& m1((**iter).event.getArguments());
-        i = m1.begin();
-        const qpid::types::Variant::Map& m(i->second.asMap());
-        i = m.find("ContentType");
-        if (i != m.end())
-            contentType = i->second.asString();
-        body = exportMessageBody(**iter, contentType);
-        buff << "   <body>";
-        buff << body.toStdString();
-        buff << "</body>\n";
+    ExportJob* job = exportJob;
+    exportJob = 0;
 
-        buff << "  </message>\n";
-        iter++;
-    }
-
-    buff << " </messages>\n";
-    return QString(buff.str().c_str());
-}
-
-QString QView::exportMessageBody(const MessageIndex& header, const std::string& contentType)
-{
-    qmf::ConsoleEvent bodyEvent = qmf->fetchBody(header.args);
-    if (bodyEvent.getType() == qmf::CONSOLE_METHOD_RESPONSE) {
-        const qpid::types::Variant::Map& results(bodyEvent.getArguments());
-        qpid::types::Variant::Map::const_iterator iter = results.find("body");
-        if (iter != results.end()) {
-            return decodeBody(iter->second, contentType);
-        }
+    QString error(job->errorString());
+    if (error.isEmpty() && !job->isCancelled() && job->isClipboard()) {
+        QClipboard *clipboard = QApplication::clipboard();
+        clipboard->setText(job->text());
     }
-    return QString();
+    copyDialog->exportFinished(error);
+    job->deleteLater();
 }
 
 // SLOT: Show/Hide the Connection toolbar
@@ -617,6 +849,10 @@ QView::~QView()
     settings.setValue("mainWindowGeometry", saveGeometry());
     settings.setValue("mainWindowState", saveState());
 
+    if (exportJob) {
+        exportJob->cancel();
+        exportJob->wait();
+    }
     qmf->cancel();
     qmf->wait();
     delete qmf;
@@ -28,6 +28,12 @@
 #include "qmf-thread.h"
 #include "model-header.h"
 #include "model-queue.h"
+#include "queue-proxy.h"
+#include "sparkline-delegate.h"
+#include "stats-recorder.h"
+#include "stats-player.h"
+#include "export-job.h"
+#include "offline-source.h"
 
 class QView : public QMainWindow, private Ui::MainWindow {
     Q_OBJECT
@@ -54,11 +60,22 @@ public slots:
     void toggleMessageToolbar(bool);
     void doneAddingQueues(uint);
     void headerCtxMenu(const QPoint&);
+    void queueColumnCtxMenu(const QPoint&);
     void messageDelete();
     void queuePurge(uint);
     void queueCopy(const QString&);
-    void getHeaderIds();
-    void gotHeader(const qmf::ConsoleEvent&, const qpid::types::Variant::Map&);
+    void exportFinished();
+    void gotHeaders(const PreparedHeaderBatch&);
+    void headersRemoved(const QString&, const QList<quint32>&);
+    void messageIdsAdded(const QString&, const QList<quint32>&);
+    void headersWanted(const QList<quint32>&);
+    void toggleWindowedHeaders(bool);
+    void showTopQueues(QAction*);
+    void toggleRecording(bool);
+    void togglePlayback(bool);
+    void playbackMoved(int);
+    void toggleOfflineQueue(bool);
+    void bodyWanted(const QModelIndex&, const qmf::ConsoleEvent&, const qpid::types::Variant::Map&);
     void messageRemoved(const qmf::ConsoleEvent& event, const qpid::types::Variant::Map& callArgs);
     void gotBody(const qmf::ConsoleEvent &event, const qpid::types::Variant::Map &args, const QModelIndex& index);
     void qmfException(const QString&);
@@ -71,26 +88,37 @@ private:
 
     HeaderModel* headerModel;
     QueueTableModel* queueModel;
-    QSortFilterProxyModel* queueProxyModel;
+    QueueProxyModel* queueProxyModel;
     QItemSelectionModel* itemSelector;
 
     DialogOpen*     openDialog;
     DialogPurge*    purgeDialog;
     DialogCopy*     copyDialog;
 
+    StatsRecorder*  recorder;
+    StatsPlayer     player;
+    uint            playbackCorrelator;
+    int             playbackSecond;
+    void connectLiveQueues(bool);
+    void enableBrokerActions();
+
+    // an exported queue being browsed instead of the broker's
+    OfflineSource   offline;
+
     void createToolBars();
     void setupStatusBar();
 
     QToolBar *connectionToolBar;
     QToolBar *queueToolBar;
     QToolBar *messageToolBar;
+    QToolBar *playbackToolBar;
+    QSlider *playbackSlider;
+    QLabel *playbackTime;
     QToolButton *refreshButton;
     QMenu *headerPopupMenu;
 
-    QString exportQueue();
-    QString exportAllMessages();
-    QString exportMessageBody(const MessageIndex& header, const std::string& contentType);
-    QString decodeBody(const qpid::types::Variant& var, const std::string& contentType);
+    ExportJob*      exportJob;
+    uint            exportJobs;
 
 
 private slots:
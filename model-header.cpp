@@ -18,98 +18,146 @@
  */
 
 #include "model-header.h"
+#include "row-runs.h"
 #include <qmf/SchemaId.h>
 #include <qmf/DataAddr.h>
 #include <iostream>
 #include <QApplication>
 #include <QBrush>
 #include <QFont>
+#include <QSet>
+#include <algorithm>
 
 using std::cout;
 using std::endl;
 
-HeaderModel::HeaderModel(QObject* parent) : QAbstractItemModel(parent), nextId(1)
+// how long to collect painted placeholder rows before asking for them
+const int REQUEST_DELAY = 50;
+// rows to prefetch on each side of the painted rows
+const int PREFETCH_ROWS = 100;
+
+HeaderModel::HeaderModel(QObject* parent) : QAbstractItemModel(parent), nextId(1),
+    windowed(false), cacheLimit(10000), windowCenter(0)
+{
+    requestTimer = new QTimer(this);
+    requestTimer->setSingleShot(true);
+    requestTimer->setInterval(REQUEST_DELAY);
+    connect(requestTimer, SIGNAL(timeout()), this, SLOT(requestHeaders()));
+
+}
+
+
+// Look up the node an index refers to. Top level indexes have an
+// internalId of 0 and are found by row, so they stay valid while a
+// windowed row's header is loaded and evicted. All other indexes carry
+// the id of their node.
+MessageIndex* HeaderModel::node(const QModelIndex& index) const
+{
+    if (!index.isValid())
+        return 0;
+    if (index.internalId() == 0)
+        return summaryAt(index.row());
+    IndexMap::const_iterator iter(linkage.find(index.internalId()));
+    if (iter == linkage.end())
+        return 0;
+    return iter.value().get();
+}
+
+// The summary node of a top level row, or 0 if its header isn't loaded
+MessageIndex* HeaderModel::summaryAt(int row) const
 {
-    // These properties will be displayed at the top level of the tree
-    summaryProperties = QStringList(QString("UserId"));
-    summaryProperties << QString("ContentLength");
-    summaryProperties << QString("ContentType");
-    summaryProperties << QString("MessageId");
+    if (!windowed) {
+        if (row < 0 || row >= (int)summaries.size())
+            return 0;
+        return summaries[row].get();
+    }
 
-    // These properties are displayed on the last line of the header details
-    bodyProperties = QStringList(QString("ContentLength"));
-    bodyProperties << QString("ContentType");
-    bodyProperties << QString("ContentEncoding");
+    if (row < 0 || row >= (int)rowIds.size())
+        return 0;
+    IndexMap::const_iterator iter(messages.find(rowIds[row]));
+    if (iter == messages.end())
+        return 0;
+    return iter.value().get();
+}
 
+QModelIndex HeaderModel::indexOf(const MessageIndex* ptr) const
+{
+    if (ptr->nodeType == NODE_SUMMARY)
+        return createIndex(ptr->row, 0, 0);
+    return createIndex(ptr->row, 0, ptr->id);
 }
 
+// The windowed row of a message id, or -1 if it is no longer listed. The
+// hints follow the rows as they are removed, so the search is only needed
+// for a request whose hint was pruned.
+int HeaderModel::rowOf(quint32 messageId) const
+{
+    QHash<quint32, int>::const_iterator hint(requestedRows.find(messageId));
+    if (hint != requestedRows.end() && hint.value() < (int)rowIds.size() &&
+        rowIds[hint.value()] == messageId)
+        return hint.value();
+
+    std::vector<quint32>::const_iterator iter(std::find(rowIds.begin(), rowIds.end(), messageId));
+    if (iter == rowIds.end())
+        return -1;
+    return iter - rowIds.begin();
+}
 
-void HeaderModel::renumber(IndexList& list)
+// Fix the row numbers of the nodes from first to the end of the list
+void HeaderModel::renumber(IndexList& list, int first)
 {
-    int sequence = 0;
-    for (IndexList::iterator iter = list.begin(); iter != list.end(); iter++)
-        (*iter)->row = sequence++;
+    for (int row = first; row < (int)list.size(); row++)
+        list[row]->row = row;
 }
 
 
 MessageIndexPtr
-HeaderModel::updateOrInsertNode(IndexList& list, NodeType nodeType, MessageIndexPtr parent,
+HeaderModel::updateOrInsertNode(IndexList& list, NodeType nodeType, MessageIndex* parent,
                               const QMap<QString, QString>& keyValues,
                               const std::string& messageId,
                               const qmf::ConsoleEvent& event,
                               const qpid::types::Variant::Map& map, QModelIndex parentIndex)
 {
     MessageIndexPtr node;
-    int rowCount;
     bool prevChanged;
 
-    IndexList::iterator iter(list.begin());
-    rowCount = 0;
-
     if (nodeType == NODE_SUMMARY) {
-        // Look for the unique messageId in the top level nodes
-        while (iter != list.end() && messageId != (*iter)->messageId) {
-            iter++;
-            rowCount++;
+        // Look up the unique messageId in the top level nodes
+        IndexMap::const_iterator iter(messages.find(QString(messageId.c_str()).toUInt()));
+        if (iter != messages.end())
+            node = iter.value();
+    } else {
+        // all other nodes may have the same messageId, so look for the keys.
+        // There are only a handful of children per message.
+        QList<QString> keys(keyValues.keys());
+        for (IndexList::const_iterator iter = list.begin(); iter != list.end(); iter++) {
+            if ((*iter)->nameValues.keys() == keys) {
+                node = *iter;
+                break;
+            }
         }
-    } else while (iter != list.end() && (keyValues.keys() != (*iter)->nameValues.keys())) {
-        // all other nodes may have the same messageId, so look for the keys
-        iter++;
-        rowCount++;
     }
 
-    if (iter == list.end()) {
-        // A new data record needs to be inserted in the list.
-        beginInsertRows(parentIndex, rowCount, rowCount);
-        node.reset(new MessageIndex());
-        node->id = nextId++;
-        linkage[node->id] = node;
-        node->nodeType = nodeType;
-        node->expanded = false;
-        node->messageId = messageId;
-        node->parent = parent;
-        node->event = event;
-        node->args = map;
-        node->nameValues = keyValues;
-
+    if (!node) {
+        // A new data record is appended to the list.
+        int row = (int)list.size();
+        beginInsertRows(parentIndex, row, row);
+        node = newNode(nodeType, parent, row, keyValues, messageId, event, map);
         list.push_back(node);
-        renumber(list);
         endInsertRows();
     } else {
-        node = *iter;
-
         prevChanged = node->changed;
         if (node->nameValues.values() != keyValues.values()) {
-            node->text = "";
+            node->text.clear();
             node->changed = true;
         }
         else
             node->changed = false;
         node->nameValues = keyValues;
 
-        QModelIndex tl = createIndex(node->row, 0, node->id);
+        QModelIndex tl = indexOf(node.get());
         // we are updating an existing node
-        if ((node->text == "") || (prevChanged != node->changed)) {
+        if (node->text.isEmpty() || (prevChanged != node->changed)) {
             // redraw the row that was just changed
             emit dataChanged ( tl, tl );
         } else if (node->nodeType == NODE_BODY) {
@@ -128,136 +176,323 @@ HeaderModel::updateOrInsertNode(IndexList& list, NodeType nodeType, MessageIndex
     return node;
 }
 
+MessageIndexPtr HeaderModel::newNode(NodeType nodeType, MessageIndex* parent, int row,
+                                     const QMap<QString, QString>& keyValues,
+                                     const std::string& messageId,
+                                     const qmf::ConsoleEvent& event,
+                                     const qpid::types::Variant::Map& map)
+{
+    MessageIndexPtr node(new MessageIndex());
+    node->id = nextId++;
+    node->row = row;
+    linkage.insert(node->id, node);
+    node->nodeType = nodeType;
+    node->expanded = false;
+    node->changed = false;
+    node->populated = false;
+    node->messageId = messageId;
+    node->parent = parent;
+    node->event = event;
+    node->args = map;
+    node->nameValues = keyValues;
+
+    if (nodeType == NODE_SUMMARY)
+        messages.insert(QString(messageId.c_str()).toUInt(), node);
+    return node;
+}
 
-void HeaderModel::addHeader(const qmf::ConsoleEvent& event, const qpid::types::Variant::Map& callArgs)
+// Windowed mode: the row of a message already exists, a header arriving
+// for it only fills in the row. The caller evicts once it is done with
+// the node.
+MessageIndexPtr HeaderModel::cacheSummary(const QMap<QString, QString>& keyValues,
+                                          const std::string& messageId,
+                                          const qmf::ConsoleEvent& event,
+                                          const qpid::types::Variant::Map& map)
 {
-    // get the messageId that was passed to the qmf call
-    std::string messageId;
-    qpid::types::Variant::Map::const_iterator iter = callArgs.find("id");
-    if (iter != callArgs.end())
-        messageId = iter->second.asString();
+    quint32 id(QString(messageId.c_str()).toUInt());
+    if (messages.contains(id))
+        return updateOrInsertNode(summaries, NODE_SUMMARY, 0, keyValues, messageId,
+                                  event, map, QModelIndex());
+
+    int row = rowOf(id);
+    requestedRows.remove(id);
+    if (row < 0)
+        return MessageIndexPtr();
+
+    MessageIndexPtr node(newNode(NODE_SUMMARY, 0, row, keyValues, messageId, event, map));
+    QModelIndex tl(indexOf(node.get()));
+    emit dataChanged(tl, tl);
+    return node;
+}
 
-    // get the arguments returned in the call results
-    const qpid::types::Variant::Map& args(event.getArguments());
+// Drop a cached summary node and its children. The row itself stays.
+void HeaderModel::forget(const MessageIndexPtr& ptr)
+{
+    if (!ptr->children.empty()) {
+        beginRemoveRows(indexOf(ptr.get()), 0, ptr->children.size() - 1);
+        for (IndexList::const_iterator iter = ptr->children.begin(); iter != ptr->children.end(); iter++)
+            unlink(*iter);
+        ptr->children.clear();
+        endRemoveRows();
+    }
+    ptr->populated = false;
+    messages.remove(QString(ptr->messageId.c_str()).toUInt());
+    linkage.remove(ptr->id);
+}
 
-    // loop throught the retuened arguments and add them to the header tree
-    for (iter = args.begin();
-       iter != args.end(); iter++) {
+// Keep the number of cached headers under the limit by dropping the ones
+// furthest from the rows that were last shown. Expanded rows are kept.
+void HeaderModel::evict()
+{
+    if (!windowed || (uint)messages.size() <= cacheLimit)
+        return;
 
-       QMap<QString, QString> detailMap;
-       QMap<QString, QString> summMap;
-       summMap[""] = QString(messageId.c_str());
-       QMap<QString, QString> bodyMap;
+    std::vector<std::pair<int, quint32> > distances;
+    distances.reserve(messages.size());
+    for (IndexMap::const_iterator iter = messages.begin(); iter != messages.end(); ++iter) {
+        if (!iter.value()->expanded)
+            distances.push_back(std::make_pair(qAbs(iter.value()->row - windowCenter), iter.key()));
+    }
+    std::sort(distances.begin(), distances.end());
+
+    // evict down to 90% so this isn't done for every header that arrives
+    uint target = cacheLimit - cacheLimit / 10;
+    while (!distances.empty() && (uint)messages.size() > target) {
+        MessageIndexPtr ptr(messages.value(distances.back().second));
+        distances.pop_back();
+        forget(ptr);
+        QModelIndex tl(createIndex(ptr->row, 0, 0));
+        emit dataChanged(tl, tl);
+    }
+}
 
-       qpid::types::Variant::Map attrs = (iter->second).asMap();
-       // each argument in the map is concatenated
-       for (qpid::types::Variant::Map::const_iterator iter = attrs.begin();
-            iter != attrs.end(); iter++) {
 
-            QString name(iter->first.c_str());
-            QString value(iter->second.asString().c_str());
+// Only the summary node of a message is created when its header arrives.
+// The header itself stays in the node's ConsoleEvent until the row is
+// expanded, then populate() builds the detail and body children from it.
+// The headers were converted for display by a HeaderPreparer, all that is
+// left to do here is splice them in.
+void HeaderModel::addHeaders(const PreparedHeaderBatch& batch, const QString& queue)
+{
+    for (std::vector<PreparedHeader>::const_iterator header = batch->begin();
+         header != batch->end(); header++) {
 
-            switch (iter->second.getType()) {
-            case qpid::types::VAR_UINT8:
-            case qpid::types::VAR_UINT16:
-            case qpid::types::VAR_UINT32:
-            case qpid::types::VAR_UINT64:
-            case qpid::types::VAR_INT8:
-            case qpid::types::VAR_INT16:
-            case qpid::types::VAR_INT32:
-            case qpid::types::VAR_INT64:
-                value = QString::number((qulonglong)iter->second.asUint64());
-                break;
-            case qpid::types::VAR_FLOAT:
-            case qpid::types::VAR_DOUBLE:
-                value = QString::number((double)iter->second.asDouble());
-                break;
+        // the selection moved on while the header was on its way
+        if (header->queue != queue)
+            continue;
 
-            case qpid::types::VAR_STRING:
-            case qpid::types::VAR_BOOL:
-            case qpid::types::VAR_UUID:
-            case qpid::types::VAR_VOID:
-                value = "\"" + QString(iter->second.asString().c_str()) + "\"";
-                break;
-            case qpid::types::VAR_MAP:
-                value = QString("<map/>");
-                break;
-            case qpid::types::VAR_LIST:
-                value = QString("<list/>");
-                break;
-            }
+        // add the top level summary node in the tree
+        MessageIndexPtr pptr;
+        if (windowed)
+            pptr = cacheSummary(header->summary, header->messageId, header->event, header->args);
+        else
+            pptr = updateOrInsertNode(this->summaries, NODE_SUMMARY, 0,
+                                      header->summary, header->messageId,
+                                      header->event, header->args, QModelIndex());
+        if (!pptr)
+            continue;
+        pptr->event = header->event;
+        pptr->args = header->args;
+        pptr->text = header->summaryText;
+
+        // the children are only kept up to date once they exist. A header
+        // read from a file has no response to build them from later.
+        if (pptr->populated || !header->event.isValid())
+            populate(pptr.get(), *header);
+    }
 
-            // add the property to either the body node or a detail node
-            if (bodyProperties.contains(name)) {
-                bodyMap[name] = value;
-            } else {
-                detailMap[name] = value;
-            }
+    // only once every node of the batch is in place and populated, so a
+    // node isn't evicted while its children are still being added
+    evict();
+}
 
-            // also add the property to the summary node if appropriate
-            if (summaryProperties.contains(name)) {
-                summMap[name] = value;
-            }
+// Create or update the detail and body children of a summary node
+void HeaderModel::populate(MessageIndex* pptr, const PreparedHeader& header)
+{
+    QModelIndex parentIndex(indexOf(pptr));
 
-        }
-        // add the top level summary node in the tree
-        MessageIndexPtr pptr(updateOrInsertNode(this->summaries, NODE_SUMMARY, MessageIndexPtr(),
-                                             summMap, messageId,
-                                             event, callArgs, QModelIndex()));
-
-        // add all the message properties
-        QMap<QString, QString>::const_iterator iter = detailMap.constBegin();
-        QMap<QString, QString> prop;
-        for (; iter != detailMap.constEnd(); ++iter) {
-            prop.clear();
-            prop[iter.key()] = iter.value();
-            updateOrInsertNode(pptr->children, NODE_DETAIL, pptr,
-                  prop, messageId,
-                  event, callArgs, createIndex(pptr->row, 0, pptr->id));
-        }
-        // add the message body properties last
-        MessageIndexPtr sptr(updateOrInsertNode(pptr->children, NODE_BODY, pptr,
-              bodyMap, messageId,
-              event, callArgs, createIndex(pptr->row, 0, pptr->id)));
-        // insert a body display node
+    pptr->populated = true;
+
+    // add all the message properties
+    HeaderFields::const_iterator iter = header.details.constBegin();
+    HeaderFields prop;
+    for (; iter != header.details.constEnd(); ++iter) {
         prop.clear();
-        prop["body"] = "...";
-        if (sptr->children.size() == 0)
-            updateOrInsertNode(sptr->children, NODE_BODY_DISPLAY, sptr,
-                         prop, messageId,
-                         event, callArgs, createIndex(sptr->row, 0, sptr->id));
+        prop[iter.key()] = iter.value();
+        updateOrInsertNode(pptr->children, NODE_DETAIL, pptr,
+              prop, pptr->messageId,
+              pptr->event, pptr->args, parentIndex);
     }
+    // add the message body properties last
+    MessageIndexPtr sptr(updateOrInsertNode(pptr->children, NODE_BODY, pptr,
+          header.body, pptr->messageId,
+          pptr->event, pptr->args, parentIndex));
+    // insert a body display node
+    prop.clear();
+    prop["body"] = "...";
+    if (sptr->children.size() == 0)
+        updateOrInsertNode(sptr->children, NODE_BODY_DISPLAY, sptr.get(),
+                     prop, pptr->messageId,
+                     pptr->event, pptr->args, indexOf(sptr.get()));
+}
+
+// Summary nodes always have children, they may just not be created yet
+bool HeaderModel::hasChildren(const QModelIndex& parent) const
+{
+    if (!parent.isValid())
+        return rowCount() > 0;
+
+    MessageIndex* ptr = node(parent);
+    if (!ptr)
+        return windowed && parent.internalId() == 0;
+
+    switch (ptr->nodeType) {
+    case NODE_SUMMARY:
+        return true;
+    case NODE_BODY:
+        return !ptr->children.empty();
+    default:
+        break;
+    }
+    return false;
+}
+
+bool HeaderModel::canFetchMore(const QModelIndex& parent) const
+{
+    MessageIndex* ptr = node(parent);
+    return ptr && ptr->nodeType == NODE_SUMMARY && !ptr->populated;
+}
+
+// A summary row was expanded for the first time. Only this one header
+// is converted here, on the GUI thread.
+void HeaderModel::fetchMore(const QModelIndex& parent)
+{
+    MessageIndex* ptr = node(parent);
+    if (!ptr || ptr->nodeType != NODE_SUMMARY || ptr->populated || !ptr->event.isValid())
+        return;
+
+    std::vector<PreparedHeader> headers;
+    PreparedHeader::prepare(ptr->event, ptr->args, headers);
+    for (std::vector<PreparedHeader>::const_iterator header = headers.begin();
+         header != headers.end(); header++)
+        populate(ptr, *header);
+}
+
+// Forget the id linkage of a node and all of its children
+void HeaderModel::unlink(const MessageIndexPtr& node)
+{
+    for (IndexList::const_iterator iter = node->children.begin(); iter != node->children.end(); iter++)
+        unlink(*iter);
+    linkage.remove(node->id);
 }
 
 void HeaderModel::clear()
 {
-    beginRemoveRows(QModelIndex(), 0, summaries.size() - 1);
+    int count = rowCount();
+    if (count == 0)
+        return;
+    beginRemoveRows(QModelIndex(), 0, count - 1);
     summaries.clear();
+    rowIds.clear();
     linkage.clear();
+    messages.clear();
+    requestedRows.clear();
+    paintedRows.clear();
     endRemoveRows();
 }
 
+// Switch between holding every header and holding only the headers of the
+// rows near the ones being shown
+void HeaderModel::setWindowed(bool on)
+{
+    if (on == windowed)
+        return;
+    clear();
+    windowed = on;
+}
 
-void HeaderModel::expanded(const QModelIndex &index)
+void HeaderModel::setCacheLimit(uint limit)
 {
-    quint32 id(index.internalId());
-    IndexMap::const_iterator iter(linkage.find(id));
-    if (iter == linkage.end())
+    cacheLimit = limit > 0 ? limit : 1;
+    evict();
+}
+
+// Windowed mode: new messages arrived on the queue. They get a row now,
+// their headers are fetched when they are shown.
+void HeaderModel::addMessageIds(const QList<quint32>& ids)
+{
+    if (!windowed || ids.isEmpty())
         return;
-    const MessageIndexPtr ptr(iter->second);
 
-    ptr->expanded = true;
+    int first = (int)rowIds.size();
+    beginInsertRows(QModelIndex(), first, first + ids.size() - 1);
+    rowIds.reserve(rowIds.size() + ids.size());
+    for (QList<quint32>::const_iterator iter = ids.begin(); iter != ids.end(); iter++)
+        rowIds.push_back(*iter);
+    endInsertRows();
 }
 
-void HeaderModel::collapsed(const QModelIndex &index)
+// Collect the placeholder rows that were painted and ask for their
+// headers, plus a page either side so scrolling finds them ready.
+void HeaderModel::requestHeaders()
 {
-    quint32 id(index.internalId());
-    IndexMap::const_iterator iter(linkage.find(id));
-    if (iter == linkage.end())
+    if (!windowed || paintedRows.isEmpty())
         return;
-    const MessageIndexPtr ptr(iter->second);
 
-    ptr->expanded = false;
+    int low = paintedRows.first();
+    int high = low;
+    for (QList<int>::const_iterator iter = paintedRows.begin(); iter != paintedRows.end(); iter++) {
+        low = qMin(low, *iter);
+        high = qMax(high, *iter);
+    }
+    paintedRows.clear();
+
+    // rows may have gone since they were painted
+    high = qMin(high, (int)rowIds.size() - 1);
+    low = qMin(low, high);
+    if (high < 0)
+        return;
+    windowCenter = (low + high) / 2;
+
+    int margin = qMin(qMax(high - low, PREFETCH_ROWS), (int)cacheLimit / 4);
+    int first = qMax(low - margin, 0);
+    int last = qMin(high + margin, (int)rowIds.size() - 1);
+
+    // the hints of requests that were dropped for newer ones are not
+    // needed. They go before the new ones are added.
+    if ((uint)requestedRows.size() > 4 * cacheLimit)
+        requestedRows.clear();
+
+    // the painted rows first, then below them, then above them
+    QList<quint32> ids;
+    for (int row = low; row <= last; row++) {
+        if (!messages.contains(rowIds[row])) {
+            ids.append(rowIds[row]);
+            requestedRows.insert(rowIds[row], row);
+        }
+    }
+    for (int row = low - 1; row >= first; row--) {
+        if (!messages.contains(rowIds[row])) {
+            ids.append(rowIds[row]);
+            requestedRows.insert(rowIds[row], row);
+        }
+    }
+    if (!ids.isEmpty())
+        emit headersWanted(ids);
+}
+
+void HeaderModel::expanded(const QModelIndex &index)
+{
+    MessageIndex* ptr = node(index);
+    if (ptr)
+        ptr->expanded = true;
+}
+
+void HeaderModel::collapsed(const QModelIndex &index)
+{
+    MessageIndex* ptr = node(index);
+    if (ptr)
+        ptr->expanded = false;
 }
 
 void HeaderModel::selected(const QModelIndex& index)
@@ -265,18 +500,16 @@ void HeaderModel::selected(const QModelIndex& index)
     //
     // Get the data record linked to the ID.
     //
-    quint32 id(index.internalId());
-    IndexMap::const_iterator iter(linkage.find(id));
-    if (iter == linkage.end())
+    MessageIndex* ptr = node(index);
+    if (!ptr)
         return;
-    const MessageIndexPtr ptr(iter->second);
 
     switch (ptr->nodeType) {
     case NODE_SUMMARY:
         emit summarySelected(index);
         break;
     case NODE_BODY:
-        if (ptr->children.front()->text == "")
+        if (ptr->children.front()->text.isEmpty())
             emit bodySelected(index, ptr->event, ptr->args);
         break;
     default:
@@ -286,20 +519,18 @@ void HeaderModel::selected(const QModelIndex& index)
 
 void HeaderModel::setBodyText(const QModelIndex& index, const QString& body)
 {
-    quint32 id(index.internalId());
-    IndexMap::const_iterator iter(linkage.find(id));
-    if (iter == linkage.end())
+    MessageIndex* ptr = node(index);
+    if (!ptr)
         return;
-    const MessageIndexPtr ptr(iter->second);
 
     MessageIndexPtr bodyNode(ptr->children.front());
 
     bodyNode->changed = false;
-    if (bodyNode->text != body.toStdString()) {
-        bodyNode->text = "";
+    if (bodyNode->text != body) {
+        bodyNode->text.clear();
         bodyNode->nameValues["body"] = body;
         bodyNode->changed = true;
-        QModelIndex tl = createIndex(bodyNode->row, 0, bodyNode->id);
+        QModelIndex tl = indexOf(bodyNode.get());
         emit dataChanged ( tl, tl );
     }
 }
@@ -311,16 +542,14 @@ int HeaderModel::rowCount(const QModelIndex &parent) const
     // If the parent is invalid (top-level), return the number of summaries.
     //
     if (!parent.isValid())
-        return (int) summaries.size();
+        return windowed ? (int) rowIds.size() : (int) summaries.size();
 
     //
     // Get the data record linked to the ID.
     //
-    quint32 id(parent.internalId());
-    IndexMap::const_iterator iter(linkage.find(id));
-    if (iter == linkage.end())
+    MessageIndex* ptr = node(parent);
+    if (!ptr)
         return 0;
-    const MessageIndexPtr ptr(iter->second);
 
     //
     // For parents, return the number of children.
@@ -347,35 +576,144 @@ int HeaderModel::columnCount(const QModelIndex &parent) const
     return 1;
 }
 
-// SLOT triggered when a message in the tree is updated
-void HeaderModel::updating(quint32 id, quint32 correlator)
+// SLOT triggered when messages have left the queue (because they were consumed)
+// Remove their records from the tree in one pass
+void HeaderModel::removeHeaders(const QList<quint32>& ids)
 {
-    QString mId = QString::number(id);
+    if (windowed) {
+        removeWindowedRows(QSet<quint32>::fromList(ids));
+        return;
+    }
+
+    // flag the rows to remove
+    std::vector<bool> gone(summaries.size(), false);
+    for (QList<quint32>::const_iterator iter = ids.begin(); iter != ids.end(); iter++) {
+        IndexMap::const_iterator found(messages.find(*iter));
+        if (found != messages.end())
+            gone[found.value()->row] = true;
+    }
+
+    RowRunList runs(flaggedRuns(gone));
+    if (runs.empty())
+        return;
+
+    // the drained messages are scattered, close up the rows in one pass
+    if ((int)runs.size() > MAX_REMOVE_RUNS) {
+        emit layoutAboutToBeChanged();
+        for (int row = 0; row < (int)summaries.size(); row++) {
+            if (gone[row]) {
+                messages.remove(QString(summaries[row]->messageId.c_str()).toUInt());
+                unlink(summaries[row]);
+            }
+        }
+        eraseFlagged(summaries, gone);
+        renumber(summaries, 0);
+        movePersistentRows(keptRows(gone));
+        emit layoutChanged();
+        return;
+    }
+
+    // remove each contiguous run of flagged rows, bottom up
+    for (RowRunList::const_iterator run = runs.begin(); run != runs.end(); run++) {
+        int first = run->first;
+        int last = run->second;
+
+        beginRemoveRows(QModelIndex(), first, last);
+        for (int idx = first; idx <= last; idx++) {
+            messages.remove(QString(summaries[idx]->messageId.c_str()).toUInt());
+            unlink(summaries[idx]);
+        }
+        summaries.erase(summaries.begin() + first, summaries.begin() + last + 1);
+        renumber(summaries, first);
+        endRemoveRows();
+    }
+}
+
+// Windowed mode: remove the rows of the messages that left the queue. The
+// cached headers below each removed run move up with their rows.
+void HeaderModel::removeWindowedRows(const QSet<quint32>& gone)
+{
+    std::vector<bool> flagged(rowIds.size(), false);
+    for (int row = 0; row < (int)rowIds.size(); row++) {
+        if (gone.contains(rowIds[row]))
+            flagged[row] = true;
+    }
 
-    for (IndexList::iterator iter = summaries.begin(); iter != summaries.end(); iter++) {
-        MessageIndexPtr record = *iter;
-        if (mId.toStdString() == (*iter)->messageId) {
-            (*iter)->correlator = correlator;
-            break;
+    RowRunList runs(flaggedRuns(flagged));
+    if (runs.empty())
+        return;
+
+    // the painted row numbers are out of date, the view paints the rows
+    // again once they have moved
+    paintedRows.clear();
+
+    // keep the hints of outstanding requests on their rows
+    std::vector<int> kept(keptRows(flagged));
+    for (QHash<quint32, int>::iterator hint = requestedRows.begin(); hint != requestedRows.end(); ) {
+        int row = hint.value() < (int)kept.size() ? kept[hint.value()] : -1;
+        if (row < 0) {
+            hint = requestedRows.erase(hint);
+        } else {
+            hint.value() = row;
+            ++hint;
+        }
+    }
+
+    // drop the cached headers of the rows that are going
+    for (int row = 0; row < (int)rowIds.size(); row++) {
+        if (!flagged[row])
+            continue;
+        MessageIndexPtr cached(messages.value(rowIds[row]));
+        if (cached) {
+            unlink(cached);
+            messages.remove(rowIds[row]);
+        }
+    }
+
+    if ((int)runs.size() > MAX_REMOVE_RUNS) {
+        emit layoutAboutToBeChanged();
+        for (IndexMap::const_iterator iter = messages.begin(); iter != messages.end(); ++iter)
+            iter.value()->row = kept[iter.value()->row];
+        eraseFlagged(rowIds, flagged);
+        movePersistentRows(kept);
+        emit layoutChanged();
+        return;
+    }
+
+    for (RowRunList::const_iterator run = runs.begin(); run != runs.end(); run++) {
+        int first = run->first;
+        int last = run->second;
+        int count = last - first + 1;
+
+        beginRemoveRows(QModelIndex(), first, last);
+        rowIds.erase(rowIds.begin() + first, rowIds.begin() + last + 1);
+        for (IndexMap::const_iterator iter = messages.begin(); iter != messages.end(); ++iter) {
+            if (iter.value()->row > last)
+                iter.value()->row -= count;
         }
+        endRemoveRows();
     }
 }
 
-// SLOT triggered when all the messages in the tree have been updated
-// Remove all messages that did not get updated (because they were consumed)
-void HeaderModel::expire(quint32 correlator)
+// Move the persistent indexes after the top level rows were closed up.
+// Top level indexes are found by row, the others by node id, so only the
+// top level rows move; indexes whose node was unlinked are dropped.
+void HeaderModel::movePersistentRows(const std::vector<int>& kept)
 {
-    int row = 0;
-    for (IndexList::iterator iter = summaries.begin(); iter != summaries.end(); iter++) {
-        MessageIndexPtr record = *iter;
-        if ((*iter)->correlator != correlator) {
-            beginRemoveRows( QModelIndex(), row, row );
-            iter = summaries.erase(iter);
-            --row;
-            endRemoveRows();
+    QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    for (int idx = 0; idx < from.size(); idx++) {
+        const QModelIndex& old(from[idx]);
+        if (old.internalId() == 0) {
+            int row = kept[old.row()];
+            to.append(row < 0 ? QModelIndex() : createIndex(row, old.column(), 0));
+        } else if (linkage.contains(old.internalId())) {
+            to.append(old);
+        } else {
+            to.append(QModelIndex());
         }
-        ++row;
     }
+    changePersistentIndexList(from, to);
 }
 
 QVariant HeaderModel::data(const QModelIndex &index, int role) const
@@ -386,44 +724,35 @@ QVariant HeaderModel::data(const QModelIndex &index, int role) const
 
     if (role == Qt::DisplayRole || role == Qt::BackgroundRole || role == Qt::ForegroundRole) {
 
-        //
-        // Note that we don't look at the row number in this function.  The index structure
-        // is defined such that the internalId is sufficient to identify the data record being
-        // interrogated.
-        //
-
         //
         // Get the data record linked to the ID.
         //
-        quint32 id(index.internalId());
-        IndexMap::const_iterator liter(linkage.find(id));
-        if (liter == linkage.end())
+        MessageIndex* ptr = node(index);
+        if (!ptr) {
+            // a windowed row whose header isn't here yet
+            if (windowed && index.internalId() == 0 && index.row() < (int)rowIds.size()) {
+                if (role == Qt::ForegroundRole)
+                    return QBrush(Qt::gray);
+                if (role == Qt::DisplayRole) {
+                    paintedRows.append(index.row());
+                    if (!requestTimer->isActive())
+                        requestTimer->start();
+                    return QString::number(rowIds[index.row()]);
+                }
+            }
             return QVariant();
-        const MessageIndexPtr ptr(liter->second);
+        }
 
         if (role == Qt::DisplayRole) {
-            if (ptr->text == "") {
-                std::string text;
-                std::string sep;
-                QMap<QString, QString>::const_iterator iter = ptr->nameValues.constBegin();
-                for (; iter != ptr->nameValues.constEnd(); ++iter) {
-                    text += sep;
-                    if (ptr->nodeType != NODE_BODY_DISPLAY) {
-                        if (iter.key() != "") {
-                            text += iter.key().toStdString();
-                            text += "=";
-                            sep = ", ";
-                        }
-                    }
-                    text += iter.value().toStdString();
-                }
+            if (ptr->text.isEmpty()) {
+                QString text(headerText(ptr->nameValues, ptr->nodeType != NODE_BODY_DISPLAY));
                 // none of the message body properties were sent
-                if ((ptr->nodeType == NODE_BODY) && (text == ""))
+                if ((ptr->nodeType == NODE_BODY) && text.isEmpty())
                     text = "Message body";
 
                 ptr->text = text;
             }
-            return QString(ptr->text.c_str());
+            return ptr->text;
         }
         if (ptr->changed) {
             if (role == Qt::ForegroundRole) {
@@ -448,15 +777,12 @@ QVariant HeaderModel::data(const QModelIndex &index, int role) const
 
 const qpid::types::Variant::Map& HeaderModel::args(const QModelIndex& index)
 {
-    if (index.isValid()) {
-        quint32 id(index.internalId());
-        IndexMap::const_iterator liter(linkage.find(id));
-        if (liter != linkage.end()) {
-            const MessageIndexPtr ptr(liter->second);
-            return ptr->args;
-        }
-    }
-    return qpid::types::Variant::Map();
+    static const qpid::types::Variant::Map emptyMap;
+
+    MessageIndex* ptr = node(index);
+    if (ptr)
+        return ptr->args;
+    return emptyMap;
 }
 
 QVariant HeaderModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -469,18 +795,12 @@ QVariant HeaderModel::headerData(int section, Qt::Orientation orientation, int r
 
 QModelIndex HeaderModel::parent(const QModelIndex& index) const
 {
-    if (!index.isValid())
-        return QModelIndex();
-
-    quint32 id(index.internalId());
-
     //
     // Get the linked record
     //
-    IndexMap::const_iterator iter(linkage.find(id));
-    if (iter == linkage.end())
+    MessageIndex* ptr = node(index);
+    if (!ptr)
         return QModelIndex();
-    MessageIndexPtr ptr(iter->second);
 
     //
     // Handle the top level node case
@@ -491,41 +811,32 @@ QModelIndex HeaderModel::parent(const QModelIndex& index) const
     //
     // Handle the schema and instance level cases
     //
-    return createIndex(ptr->parent->row, 0, ptr->parent->id);
+    return indexOf(ptr->parent);
 }
 
 
 QModelIndex HeaderModel::index(int row, int column, const QModelIndex &parent) const
 {
     Q_UNUSED(column);
-    int count;
-    IndexList::const_iterator iter;
+
+    if (row < 0)
+        return QModelIndex();
 
     if (!parent.isValid()) {
         //
-        // Handle the top leven node case
+        // Handle the top level node case
         //
-        count = 0;
-        iter = summaries.begin();
-        while (iter != summaries.end() && count < row) {
-            count++;
-            iter++;
-        }
-
-        if (iter == summaries.end()) {
+        if (row >= rowCount())
             return QModelIndex();
-        }
-        return createIndex(row, 0, (*iter)->id);
+        return createIndex(row, 0, 0);
     }
 
     //
     // Get the data record linked to the ID.
     //
-    quint32 id(parent.internalId());
-    IndexMap::const_iterator link = linkage.find(id);
-    if (link == linkage.end())
+    MessageIndex* ptr = node(parent);
+    if (!ptr)
         return QModelIndex();
-    MessageIndexPtr ptr(link->second);
 
     //
     // Create an index for the child data record.
@@ -538,47 +849,16 @@ QModelIndex HeaderModel::index(int row, int column, const QModelIndex &parent) c
     // these have children
     case NODE_BODY:
     case NODE_SUMMARY:
-        count = 0;
-        iter = ptr->children.begin();
-        while (count < row) {
-            iter++;
-            count++;
-        }
-
-        if (iter == summaries.end())
+        if (row >= (int)ptr->children.size())
             return QModelIndex();
-        return createIndex(row, 0, (*iter)->id);
+        return createIndex(row, 0, ptr->children[row]->id);
     }
 
     return QModelIndex();
 }
 
-std::ostream& operator<<(std::ostream& out, const MessageIndex& header)
-{
-    out << "   <arguments>\n";
-
-    // get the arguments returned in the call results
-    const qpid::types::Variant::Map& args(header.event.getArguments());
-
-    // loop through the retuened arguments and add them to the xml stream
-    qpid::types::Variant::Map::const_iterator iter;
-    for (iter = args.begin();
-       iter != args.end(); iter++) {
-
-       qpid::types::Variant::Map attrs = (iter->second).asMap();
-       for (qpid::types::Variant::Map::const_iterator iter = attrs.begin();
-            iter != attrs.end(); iter++) {
-            out << "    <argument>\n";
-            out << "      <name>" << iter->first << "</name>\n";
-            out << "      <value>" << iter->second << "</value>\n";
-            out << "    </argument>\n";
-        }
-    }
-
-    out << "   </arguments>\n";
-    return out;
-}
-
+// Every header of the queue. Empty in windowed mode, where only the
+// headers of the rows shown recently are held.
 const IndexList& HeaderModel::getMessageHeaderList()
 {
     return this->summaries;
@@ -23,24 +23,27 @@
 #include <QModelIndex>
 #include <QMutex>
 #include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
 #include <qmf/Data.h>
 #include <qmf/ConsoleEvent.h>
 #include <qpid/types/Variant.h>
 #include <sstream>
 #include <string>
-#include <map>
-#include <list>
-#include <deque>
+#include <vector>
 #include <boost/shared_ptr.hpp>
+#include "header-preparer.h"
 
 Q_DECLARE_METATYPE(qmf::Data);
 Q_DECLARE_METATYPE(qmf::ConsoleEvent);
 Q_DECLARE_METATYPE(qpid::types::Variant::Map);
+Q_DECLARE_METATYPE(QList<quint32>);
 
 class MessageIndex;
 typedef boost::shared_ptr<MessageIndex> MessageIndexPtr;
-typedef std::map<quint32, MessageIndexPtr> IndexMap;
-typedef std::list<MessageIndexPtr> IndexList;
+typedef QHash<quint32, MessageIndexPtr> IndexMap;
+typedef std::vector<MessageIndexPtr> IndexList;
 
 class HeaderModel : public QAbstractItemModel {
     Q_OBJECT
@@ -54,42 +57,83 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
     QModelIndex parent(const QModelIndex& index) const;
     QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
     const qpid::types::Variant::Map& args(const QModelIndex& index);
 
     const IndexList& getMessageHeaderList();
+    bool isWindowed() const { return windowed; }
 
     typedef enum { NODE_SUMMARY, NODE_DETAIL, NODE_BODY, NODE_BODY_DISPLAY } NodeType;
 
 public slots:
-    void addHeader(const qmf::ConsoleEvent&, const qpid::types::Variant::Map&);
+    void addHeaders(const PreparedHeaderBatch&, const QString& queue);
     void clear();
     void selected(const QModelIndex&);
     void setBodyText(const QModelIndex&, const QString&);
     void expanded(const QModelIndex&);
     void collapsed(const QModelIndex&);
-    void updating(quint32 id, quint32 correlator);
-    void expire(quint32 correlator);
+    void removeHeaders(const QList<quint32>& ids);
+    void addMessageIds(const QList<quint32>& ids);
+    void setWindowed(bool);
+    void setCacheLimit(uint);
 
 signals:
     void bodySelected(const QModelIndex&, const qmf::ConsoleEvent&, const qpid::types::Variant::Map&);
     void summarySelected(const QModelIndex&);
+    // windowed mode: the headers of these messages are about to be shown
+    void headersWanted(const QList<quint32>&);
+
+private slots:
+    void requestHeaders();
 
 private:
     IndexList summaries;
+    // node id -> node, for every node in the tree
     IndexMap linkage;
+    // message id -> summary node
+    IndexMap messages;
     quint32 nextId;
 
-    void renumber(IndexList&);
-
-    MessageIndexPtr updateOrInsertNode(IndexList& list, NodeType nodeType, MessageIndexPtr parent,
+    // In windowed mode the rows are the message ids of the queue, and
+    // messages only holds the headers of rows that were shown recently.
+    // Rows with no header are fetched when the view paints them.
+    bool windowed;
+    std::vector<quint32> rowIds;
+    uint cacheLimit;
+    mutable QList<int> paintedRows;     // placeholders painted since the last request
+    QTimer* requestTimer;
+    QHash<quint32, int> requestedRows;  // where each requested id was, as a hint
+    int windowCenter;
+
+    MessageIndex* node(const QModelIndex&) const;
+    MessageIndex* summaryAt(int row) const;
+    QModelIndex indexOf(const MessageIndex*) const;
+    int rowOf(quint32 messageId) const;
+    void renumber(IndexList&, int first);
+    void unlink(const MessageIndexPtr&);
+    void populate(MessageIndex*, const PreparedHeader&);
+    MessageIndexPtr newNode(NodeType nodeType, MessageIndex* parent, int row,
+                            const QMap<QString, QString>& keyValues,
+                            const std::string& messageId,
+                            const qmf::ConsoleEvent& event,
+                            const qpid::types::Variant::Map& map);
+    MessageIndexPtr cacheSummary(const QMap<QString, QString>& keyValues,
+                                 const std::string& messageId,
+                                 const qmf::ConsoleEvent& event,
+                                 const qpid::types::Variant::Map& map);
+    void forget(const MessageIndexPtr&);
+    void evict();
+    void removeWindowedRows(const QSet<quint32>&);
+    void movePersistentRows(const std::vector<int>& kept);
+
+    MessageIndexPtr updateOrInsertNode(IndexList& list, NodeType nodeType, MessageIndex* parent,
                                   const QMap<QString, QString>& keysValues,
                                   const std::string& messageId,
                                   const qmf::ConsoleEvent& event,
                                   const qpid::types::Variant::Map& map, QModelIndex parentIndex);
 
-    QStringList summaryProperties;
-    QStringList bodyProperties;
-
     //qpid::types::Variant::Map emptyMap;
 
 };
@@ -100,10 +144,10 @@ public:
     quint32 id;
     int row;
     HeaderModel::NodeType nodeType;
-    MessageIndexPtr parent;
+    MessageIndex* parent;   // owned by the parent's children list
     IndexList children;
 
-    std::string text;       // constructed name=value list
+    QString text;           // constructed name=value list
     std::string messageId;  // unique per message
     QMap<QString, QString> nameValues;
 
@@ -112,11 +156,8 @@ public:
     qpid::types::Variant::Map args;
     bool expanded;
     bool changed;
-    quint32 correlator; // latest console event correlator used to update this record
-
+    bool populated;     // children have been created from event
 };
 
-std::ostream& operator<<(std::ostream& out, const MessageIndex& value);
-
 #endif
 
@@ -18,42 +18,89 @@
  */
 
 #include "model-queue.h"
+#include "row-runs.h"
+#include <QSettings>
+#include <QSet>
+#include <QLocale>
 #include <iostream>
 
 using std::cout;
 using std::endl;
 
-QueueTableModel::QueueTableModel(QObject* parent) : QAbstractTableModel(parent)
+static QString fmtBool(quint64 v)
 {
-    // Initialize the default columns
-    queueColumns.append(Column("name", "Name", Qt::AlignLeft, ""));
-    queueColumns.append(Column("autoDelete", "Auto Delete", Qt::AlignLeft, ""));
-    queueColumns.append(Column("msgDepth", "Messages", Qt::AlignRight, "N"));
-    queueColumns.append(Column("byteDepth", "Bytes", Qt::AlignRight, "N"));
-    queueColumns.append(Column("byteTotalEnqueues", "In Bytes", Qt::AlignRight, "N"));
-    queueColumns.append(Column("byteTotalDequeues", "Out Bytes", Qt::AlignRight, "N"));
-
-    managementQueues.append("amq.direct");
-    managementQueues.append("qmf.default.topic");
-    managementQueues.append("qmfa-");
-    managementQueues.append("qmfagent-");
-    managementQueues.append("qmfc-v2-");
-    managementQueues.append("reply-");
-    managementQueues.append("topic-");
+    return v ? QString("True") : QString("False");
 }
 
+static QString fmtNumber(quint64 v)
+{
+    return QLocale().toString((qulonglong)v);
+}
 
-bool QueueTableModel::isSystemQueue(const qmf::Data& queue)
+static QString fmtBytes(quint64 v)
 {
-    QString name = QString(queue.getProperty("name").asString().c_str());
-    QStringList::const_iterator citer = managementQueues.constBegin();
-    while (citer != managementQueues.constEnd()) {
-        if (name.startsWith(*citer))
-            return true;
-        ++citer;
+    static const char sizes[] = " KMGTPE";
+    uint which_size = 0;
+
+    while (v >= 1024) {
+        v >>= 10;
+        ++which_size;
     }
-    return false;
-    return queue.getProperty("exclusive").asBool();
+    return QString::number((qulonglong)v) + QChar(sizes[which_size]);
+}
+
+static QString fmtRate(quint64 v)
+{
+    return QLocale().toString((double)v / RATE_SCALE, 'f', 1);
+}
+
+static QString fmtByteRate(quint64 v)
+{
+    return fmtBytes(v / RATE_SCALE) + QString("/s");
+}
+
+// Every column the queue table can show. The name column has no formatter
+// and must stay first: the filter box matches against column 0.
+static const QueueColumn columnTable[] = {
+    { QP_NAME,          "Name",         Qt::AlignLeft | Qt::AlignVCenter,  0,          true },
+    { QP_AUTO_DELETE,   "Auto Delete",  Qt::AlignLeft | Qt::AlignVCenter,  fmtBool,    true },
+    { QP_MSG_DEPTH,     "Messages",     Qt::AlignRight | Qt::AlignVCenter, fmtNumber,  true },
+    { QP_BYTE_DEPTH,    "Bytes",        Qt::AlignRight | Qt::AlignVCenter, fmtBytes,   true },
+    { QP_MSG_ENQUEUES,  "In Messages",  Qt::AlignRight | Qt::AlignVCenter, fmtNumber,  false },
+    { QP_MSG_DEQUEUES,  "Out Messages", Qt::AlignRight | Qt::AlignVCenter, fmtNumber,  false },
+    { QP_BYTE_ENQUEUES, "In Bytes",     Qt::AlignRight | Qt::AlignVCenter, fmtBytes,   true },
+    { QP_BYTE_DEQUEUES, "Out Bytes",    Qt::AlignRight | Qt::AlignVCenter, fmtBytes,   true },
+    { QP_CONSUMERS,     "Consumers",    Qt::AlignRight | Qt::AlignVCenter, fmtNumber,  false },
+    { QP_MSG_IN_RATE,   "In Msgs/s",    Qt::AlignRight | Qt::AlignVCenter, fmtRate,    false },
+    { QP_MSG_OUT_RATE,  "Out Msgs/s",   Qt::AlignRight | Qt::AlignVCenter, fmtRate,    false },
+    { QP_BYTE_IN_RATE,  "In Bytes/s",   Qt::AlignRight | Qt::AlignVCenter, fmtByteRate, false },
+    { QP_BYTE_OUT_RATE, "Out Bytes/s",  Qt::AlignRight | Qt::AlignVCenter, fmtByteRate, false }
+};
+static const int columnTableSize = sizeof(columnTable) / sizeof(columnTable[0]);
+
+QueueTableModel::QueueTableModel(QObject* parent) :
+    QAbstractTableModel(parent), topQueues(TOP_OFF), hideSystemQueues(true),
+    systemQueues(defaultSystemQueuePrefixes())
+{
+    loadColumns();
+}
+
+QStringList QueueTableModel::defaultSystemQueuePrefixes()
+{
+    QStringList prefixes;
+    prefixes.append("amq.direct");
+    prefixes.append("qmf.default.topic");
+    prefixes.append("qmfa-");
+    prefixes.append("qmfagent-");
+    prefixes.append("qmfc-v2-");
+    prefixes.append("reply-");
+    prefixes.append("topic-");
+    return prefixes;
+}
+
+bool QueueTableModel::isSystemQueue(const QString& name) const
+{
+    return systemQueues.matches(name);
 
     // when management queues are defined by an agrument, modify and enable the following:
     /*
@@ -71,44 +118,169 @@ bool QueueTableModel::isSystemQueue(const qmf::Data& queue)
     */
 }
 
-void QueueTableModel::addQueue(const qmf::Data& queue, uint correlator)
+// Add the queues of one query response. Queues already in the table are
+// updated in place, the new ones are appended with a single insert.
+void QueueTableModel::addQueues(const QueueSampleBatch& batch, uint correlator)
 {
-    if (!queue.isValid())
-        return;
+    std::vector<const QueueSample*> added;
+    QSet<QString> adding;
+
+    for (std::vector<QueueSample>::const_iterator sample = batch->begin();
+         sample != batch->end(); sample++) {
+
+        // see if the object already exists in the list
+        int row = findRow(sample->objectName);
+        if (row >= 0) {
+            stats.setCorrelator(row, correlator);
+            emitChanged(row, stats.update(row, *sample));
+            if (topQueues != TOP_OFF) {
+                top.update(row, topKey(row));
+                emitTopChanges();
+            }
+        } else if (!adding.contains(sample->objectName)) {
+            adding.insert(sample->objectName);
+            added.push_back(&*sample);
+        }
+        // else it is listed twice in this response and is already being added
+    }
 
-    // filter out system queues if required
-    if (hideSystemQueues) {
-        if (isSystemQueue(queue))
-            return;
+    if (!added.empty()) {
+        // these are new queues
+        int first = stats.size();
+        beginInsertRows(QModelIndex(), first, first + added.size() - 1);
+        for (std::vector<const QueueSample*>::const_iterator sample = added.begin();
+             sample != added.end(); sample++) {
+            int row = stats.append(**sample, correlator);
+            rowIndex.insert(stats.objectNameId(row), row);
+            cells.resize(cells.size() + QP_COUNT);
+            cached.append(0);
+            systemRows.append(isSystemQueue((*sample)->name));
+            if (topQueues != TOP_OFF)
+                top.insert(row, topKey(row));
+        }
+        endInsertRows();
+        emitTopChanges();
     }
+}
+
+// Rebuild the object name to row index after rows were removed
+void QueueTableModel::reindex()
+{
+    rowIndex.clear();
+    rowIndex.reserve(stats.size());
+    for (int idx=0; idx<stats.size(); idx++)
+        rowIndex.insert(stats.objectNameId(idx), idx);
+}
 
-    // see if the object already exists in the list
-    const qpid::types::Variant& name = queue.getProperty("name");
+// The row of a queue by its QMF object name, -1 if it isn't listed
+int QueueTableModel::findRow(const QString& objectName) const
+{
+    quint32 id = stats.nameTable().find(objectName);
+    if (id == (quint32)NameTable::NO_NAME)
+        return -1;
+    return rowIndex.value(id, -1);
+}
+
+// Emit dataChanged for each run of displayed cells whose property is in
+// the changed mask
+void QueueTableModel::emitChanged(int row, quint32 changed)
+{
+    if (changed == 0)
+        return;
+    cached[row] &= ~changed;
+    // rows that aren't shown are redrawn when they come back
+    if (!isShown(row))
+        return;
 
-    for (int idx=0; idx<dataList.size(); idx++) {
-        qmf::Data existing = dataList.at(idx);
-        if (name.isEqualTo(existing.getProperty("name"))) {
+    int col = 0;
+    while (col < queueColumns.size()) {
+        if (!(changed & (1 << columnTable[queueColumns[col]].property))) {
+            ++col;
+            continue;
+        }
+        int first = col;
+        while (col < queueColumns.size() && (changed & (1 << columnTable[queueColumns[col]].property)))
+            ++col;
+        emit dataChanged(index(row, first), index(row, col - 1));
+    }
+}
 
-            //const qpid::types::Variant::Map& map(queue.getProperties());
-            qpid::types::Variant::Map map = qpid::types::Variant::Map(queue.getProperties());
-            map["correlator"] = correlator;
+// Remove the flagged rows with one beginRemoveRows/endRemoveRows per
+// contiguous run. Runs are removed from the bottom up so the row numbers
+// of the runs still to go stay valid. When the rows are scattered over
+// many runs the table is compacted in one pass inside a layout change,
+// so the selection and the current queue survive.
+void QueueTableModel::removeFlagged(const QVector<bool>& flagged)
+{
+    RowRunList runs(flaggedRuns(flagged));
+    if (runs.empty())
+        return;
 
-            existing.overwriteProperties(map);
-            return;
+    if ((int)runs.size() > MAX_REMOVE_RUNS) {
+        // the proxy drops its rows while the source rows still exist
+        emit rowsAboutToBeErased(flagged);
+        emit layoutAboutToBeChanged();
+
+        stats.removeFlagged(flagged);
+        cells.fill(QString(), stats.size() * QP_COUNT);
+        cached.fill(0, stats.size());
+        eraseFlagged(systemRows, flagged);
+        reindex();
+        if (topQueues != TOP_OFF)
+            top.removeFlagged(flagged, topKeys());
+
+        std::vector<int> kept(keptRows(flagged));
+        QModelIndexList from = persistentIndexList();
+        QModelIndexList to;
+        for (int idx=0; idx<from.size(); idx++) {
+            int row = kept[from[idx].row()];
+            to.append(row < 0 ? QModelIndex() : index(row, from[idx].column()));
         }
+        changePersistentIndexList(from, to);
+
+        emit rowsErased(flagged);
+        emit layoutChanged();
+        emitTopChanges();
+        return;
     }
 
-    qmf::Data q = qmf::Data(queue);
-    qpid::types::Variant corr =  qpid::types::Variant(correlator);
-    q.setProperty("correlator", corr);
+    for (RowRunList::const_iterator run = runs.begin(); run != runs.end(); run++) {
+        int first = run->first;
+        int last = run->second;
+
+        beginRemoveRows(QModelIndex(), first, last);
+        stats.remove(first, last);
+        cells.remove(first * QP_COUNT, (last - first + 1) * QP_COUNT);
+        cached.remove(first, last - first + 1);
+        systemRows.remove(first, last - first + 1);
+        endRemoveRows();
+    }
+    reindex();
 
-    // this is a new queue
-    int last = dataList.size();
-    beginInsertRows(QModelIndex(), last, last);
-    dataList.append(q);
-    endInsertRows();
+    // queues further down may have moved into the top
+    if (topQueues != TOP_OFF) {
+        top.removeFlagged(flagged, topKeys());
+        emitTopChanges();
+    }
 }
 
+// Merge pushed statistics into the existing queues. Only the properties
+// in an update are changed, and only the cells that changed are redrawn.
+void QueueTableModel::updateQueues(const QueueSampleBatch& batch)
+{
+    for (std::vector<QueueSample>::const_iterator sample = batch->begin();
+         sample != batch->end(); sample++) {
+        int row = findRow(sample->objectName);
+        // a queue we haven't seen yet will be added by the next queue list
+        if (row >= 0) {
+            emitChanged(row, stats.update(row, *sample));
+            if (topQueues != TOP_OFF) {
+                top.update(row, topKey(row));
+                emitTopChanges();
+            }
+        }
+    }
+}
 
 void QueueTableModel::connectionChanged(bool isConnected)
 {
@@ -118,16 +290,83 @@ void QueueTableModel::connectionChanged(bool isConnected)
 
 void QueueTableModel::clear()
 {
-    beginRemoveRows(QModelIndex(), 0, dataList.count() - 1);
-    dataList.clear();
+    if (stats.size() == 0)
+        return;
+    beginRemoveRows(QModelIndex(), 0, stats.size() - 1);
+    stats.clear();
+    rowIndex.clear();
+    cells.clear();
+    cached.clear();
+    systemRows.clear();
+    top.clear();
     endRemoveRows();
 }
 
+// Show all the queues, or only the count largest by the mode's measure
+void QueueTableModel::setTopQueues(TopMode mode, uint count)
+{
+    if (mode == topQueues && (int)count == top.limit())
+        return;
+
+    topQueues = mode;
+    top.setLimit(count);
+    if (mode == TOP_OFF)
+        top.clear();
+    else
+        top.load(topKeys());
+
+    // cells of rows that weren't shown may be out of date
+    cached.fill(0);
+    emit shownRowsChanged();
+}
+
+void QueueTableModel::setTopQueueCount(uint count)
+{
+    setTopQueues(topQueues, count);
+}
+
+// Hidden management queues rank below every other queue, so they only
+// take up a place in the top when there aren't enough other queues
+quint64 QueueTableModel::topKey(int row) const
+{
+    if (hideSystemQueues && systemRows[row])
+        return 0;
+
+    quint64 key;
+    switch (topQueues) {
+    case TOP_MSG_DEPTH:     key = stats.value(row, QP_MSG_DEPTH); break;
+    case TOP_BYTE_DEPTH:    key = stats.value(row, QP_BYTE_DEPTH); break;
+    case TOP_ENQUEUE_RATE:  key = stats.value(row, QP_MSG_IN_RATE); break;
+    default:                key = 0; break;
+    }
+    return key == ~(quint64)0 ? key : key + 1;
+}
+
+std::vector<quint64> QueueTableModel::topKeys() const
+{
+    std::vector<quint64> keys(stats.size());
+    for (int row=0; row<stats.size(); row++)
+        keys[row] = topKey(row);
+    return keys;
+}
+
+// Tell the proxy about the rows that went in or out of the top
+void QueueTableModel::emitTopChanges()
+{
+    std::vector<int> changed;
+    top.takeChanged(changed);
+    for (std::vector<int>::const_iterator row = changed.begin(); row != changed.end(); row++) {
+        // a row coming back into view was not redrawn while it was hidden
+        cached[*row] = 0;
+        emit rowShownChanged(*row);
+    }
+}
+
 
 int QueueTableModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
-    return (int) dataList.size();
+    return stats.size();
 }
 
 
@@ -144,60 +383,78 @@ QVariant QueueTableModel::data(const QModelIndex &index, int role) const
     if (!index.isValid())
         return QVariant();
 
+    const QueueColumn& column(columnTable[queueColumns[index.column()]]);
+
     if (role == Qt::TextAlignmentRole) {
-        return queueColumns[index.column()].alignment;
+        return column.alignment;
     }
 
-    if (role != Qt::DisplayRole)
-        return QVariant();
+    int row = index.row();
 
-    const qmf::Data& queue = dataList.at(index.row());
-    const qpid::types::Variant::Map& attrs(queue.getProperties());
-    qpid::types::Variant::Map::const_iterator iter;
-
-    iter = attrs.find(queueColumns[index.column()].name);
-    if (iter == attrs.end()) {
-        return QString("--");
+    // the raw, unformatted value
+    if (role == Qt::UserRole) {
+        if (column.property == QP_NAME)
+            return stats.name(row);
+        if (!stats.has(row, column.property))
+            return QVariant();
+        return QVariant((qulonglong)stats.value(row, column.property));
     }
 
-    //return QString(iter->second.asString().c_str());
-
-    switch (iter->second.getType()) {
-    default:
-        if (queueColumns[index.column()].format == "B")
-            return fmtBytes(iter->second);
-        else if (queueColumns[index.column()].format == "N")
-            return QVariant((qulonglong)iter->second.asUint64());
-        // else display as string
-    case qpid::types::VAR_STRING:
-    case qpid::types::VAR_BOOL:
-    case qpid::types::VAR_UUID:
-    case qpid::types::VAR_VOID:
-        return QString(iter->second.asString().c_str());
-    case qpid::types::VAR_MAP:
-        return QString("<map>");
-    case qpid::types::VAR_LIST:
-        return QString("<list>");
+    if (role == SparklineRole) {
+        QVector<quint64> points(stats.trend(row, column.property));
+        if (points.size() < 2)
+            return QVariant();
+        QVariantList line;
+        for (int idx=0; idx<points.size(); idx++)
+            line.append((qulonglong)points[idx]);
+        return line;
     }
-    return QVariant();
+
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    return cell(row, column);
 }
 
-QString QueueTableModel::fmtBytes(const qpid::types::Variant& v) const
+// Compare two rows on a displayed column using the raw values, so the
+// sort doesn't go through QVariant. Missing counters sort first.
+int QueueTableModel::compare(int left, int right, int col) const
 {
-    const char *sizes = " KMGTPY";
-    uint k = 1024;
-    uint which_size = 0;
+    QueueProperty property = columnTable[queueColumns[col]].property;
+    if (property == QP_NAME)
+        return QString::compare(stats.name(left), stats.name(right));
+
+    bool hasLeft = stats.has(left, property);
+    bool hasRight = stats.has(right, property);
+    if (hasLeft != hasRight)
+        return hasLeft ? 1 : -1;
+    if (!hasLeft)
+        return 0;
+
+    quint64 leftValue = stats.value(left, property);
+    quint64 rightValue = stats.value(right, property);
+    if (leftValue == rightValue)
+        return 0;
+    return leftValue < rightValue ? -1 : 1;
+}
 
-    qlonglong b = v.asUint64();
-    while (b >= k) {
-        b /= k;
-        ++which_size;
-    }
-    if (which_size < strlen(sizes)) {
-        QChar c = QChar(sizes[which_size]);
-        return QString("%1").arg(b) + QString(&c, 1);
+// The display string for a cell, formatted only when its value has
+// changed since it was last shown
+const QString& QueueTableModel::cell(int row, const QueueColumn& column) const
+{
+    if (column.property == QP_NAME)
+        return stats.name(row);
+
+    QString& text = cells[row * QP_COUNT + column.property];
+    quint32 bit = 1 << column.property;
+    if (!(cached[row] & bit)) {
+        if (stats.has(row, column.property))
+            text = column.format(stats.value(row, column.property));
+        else
+            text = QString("--");
+        cached[row] |= bit;
     }
-    return QString().setNum(b);
+    return text;
 }
 
 QVariant QueueTableModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -205,100 +462,141 @@ QVariant QueueTableModel::headerData(int section, Qt::Orientation orientation, i
     if ((section >=0) && (section < queueColumns.size())) {
 
         if (role == Qt::TextAlignmentRole) {
-            return queueColumns[section].alignment;
+            return columnTable[queueColumns[section]].alignment;
         }
 
         if (role == Qt::DisplayRole && orientation == Qt::Horizontal) {
-            return queueColumns[section].header;
+            return QString(columnTable[queueColumns[section]].header);
         }
     }
     return QVariant();
 }
 
-const qmf::Data& QueueTableModel::selectedQueue(const QModelIndex& selectedIndex)
+int QueueTableModel::columnDescriptorCount()
+{
+    return columnTableSize;
+}
+
+const QueueColumn& QueueTableModel::columnDescriptor(int descriptor)
+{
+    return columnTable[descriptor];
+}
+
+bool QueueTableModel::isColumnVisible(int descriptor) const
 {
-    if (selectedIndex.isValid()) {
-        return dataList.at(selectedIndex.row());
+    return queueColumns.contains(descriptor);
+}
+
+// Show or hide one of the column descriptors. Visible columns keep the
+// order of the descriptor table.
+void QueueTableModel::setColumnVisible(int descriptor, bool visible)
+{
+    if (descriptor <= 0 || descriptor >= columnTableSize)
+        return;
+    if (visible == isColumnVisible(descriptor))
+        return;
+
+    int col = 0;
+    while (col < queueColumns.size() && queueColumns[col] < descriptor)
+        ++col;
+
+    if (visible) {
+        beginInsertColumns(QModelIndex(), col, col);
+        queueColumns.insert(col, descriptor);
+        endInsertColumns();
+    } else {
+        beginRemoveColumns(QModelIndex(), col, col);
+        queueColumns.remove(col);
+        endRemoveColumns();
     }
-    return qmf::Data();
+    saveColumns();
 }
 
-const qmf::Agent& QueueTableModel::selectedQueueAgent(const QModelIndex& selectedIndex)
+// The visible columns are saved as a list of queue property names
+void QueueTableModel::loadColumns()
 {
-    return dataList.at(selectedIndex.row()).getAgent();
+    QSettings settings;
+    settings.beginGroup("QueueTable");
+    bool saved = settings.contains("columns");
+    QStringList names = settings.value("columns").toStringList();
+    settings.endGroup();
+
+    queueColumns.clear();
+    for (int idx=0; idx<columnTableSize; idx++) {
+        bool visible = saved ? names.contains(queuePropertyName(columnTable[idx].property))
+                             : columnTable[idx].visible;
+        if (idx == 0 || visible)
+            queueColumns.append(idx);
+    }
+}
+
+void QueueTableModel::saveColumns()
+{
+    QStringList names;
+    for (int col=0; col<queueColumns.size(); col++)
+        names.append(queuePropertyName(columnTable[queueColumns[col]].property));
+
+    QSettings settings;
+    settings.beginGroup("QueueTable");
+    settings.setValue("columns", names);
+    settings.endGroup();
 }
 
 const qmf::DataAddr& QueueTableModel::selectedQueueDataAddr(const QModelIndex& selectedIndex)
 {
-    return dataList.at(selectedIndex.row()).getAddr();
+    return stats.addr(selectedIndex.row());
 }
 
 QString QueueTableModel::selectedQueueName(const QModelIndex& selectedIndex)
 {
-    if (selectedIndex.isValid()) {
-        qpid::types::Variant::Map::const_iterator iter;
-        const qmf::Data& queue = dataList.at(selectedIndex.row());
-        const qpid::types::Variant::Map& attrs(queue.getProperties());
-
-        iter = attrs.find("name");
-        if (iter != attrs.end())
-            return QString(iter->second.asString().c_str());
-    }
+    if (selectedIndex.isValid() && stats.has(selectedIndex.row(), QP_NAME))
+        return stats.name(selectedIndex.row());
     return QString("unknown");
 }
 
 QVariant QueueTableModel::selectedQueueDepth(const QModelIndex& selectedIndex)
 {
-    if (selectedIndex.isValid()) {
-        qpid::types::Variant::Map::const_iterator iter;
-        const qmf::Data& queue = dataList.at(selectedIndex.row());
-        const qpid::types::Variant::Map& attrs(queue.getProperties());
-
-        iter = attrs.find("msgDepth");
-        if (iter != attrs.end())
-            return QVariant(iter->second.asUint32());
-    }
+    if (selectedIndex.isValid() && stats.has(selectedIndex.row(), QP_MSG_DEPTH))
+        return QVariant((uint)stats.value(selectedIndex.row(), QP_MSG_DEPTH));
     return QVariant(0);
 }
 
+// The management queues stay in the table, they are only hidden, so
+// showing them again doesn't wait for the next queue list
 void QueueTableModel::toggleSystemQueues(bool show)
 {
-    this->hideSystemQueues = !show;
-    if (!show) {
-
-        // remove the system queues
-        for (int idx=0; idx<dataList.size(); idx++) {
-            if (isSystemQueue(dataList.at(idx))) {
-                beginRemoveRows( QModelIndex(), idx, idx );
-                dataList.removeAt(idx--);
-                endRemoveRows();
-            }
-        }
+    if (hideSystemQueues == !show)
+        return;
+    hideSystemQueues = !show;
+    shownChanged();
+}
 
-        // force a refresh of the display
-        QModelIndex topLeft = index(0, 0);
-        QModelIndex bottomRight = index(dataList.size() - 1, 2);
-        emit dataChanged ( topLeft, bottomRight );
+// Classify every queue again against the new prefixes
+void QueueTableModel::setSystemQueuePrefixes(const QStringList& prefixes)
+{
+    systemQueues = PrefixMatcher(prefixes);
+    for (int row=0; row<stats.size(); row++)
+        systemRows[row] = isSystemQueue(stats.name(row));
+    shownChanged();
+}
 
-    }
+// Work out the top again, since hidden queues rank last, and let the
+// proxy filter again. Rows that were hidden weren't redrawn.
+void QueueTableModel::shownChanged()
+{
+    if (topQueues != TOP_OFF)
+        top.load(topKeys());
+    cached.fill(0);
+    emit shownRowsChanged();
 }
 
 void QueueTableModel::refresh(uint correlator)
 {
     // remove any old queues that were not added/updated with this correlator
-    for (int idx=0; idx<dataList.size(); idx++) {
-        uint corr = dataList.at(idx).getProperty("correlator").asUint32();
-        if (corr != correlator) {
-            beginRemoveRows( QModelIndex(), idx, idx );
-            dataList.removeAt(idx--);
-            endRemoveRows();
-        }
-    }
-
-    // force a refresh of the display
-    QModelIndex topLeft = index(0, 0);
-    QModelIndex bottomRight = index(dataList.size() - 1, 2);
-    emit dataChanged ( topLeft, bottomRight );
+    QVector<bool> stale(stats.size());
+    for (int idx=0; idx<stats.size(); idx++)
+        stale[idx] = stats.correlator(idx) != correlator;
+    removeFlagged(stale);
 }
 
 std::ostream& operator<<(std::ostream& out, const qmf::Data& queue)
@@ -22,16 +22,39 @@
 #include <QAbstractTableModel>
 #include <QModelIndex>
 #include <QList>
+#include <QHash>
+#include <QVector>
 #include <QStringList>
 #include <qmf/Data.h>
+#include "queue-stats.h"
+#include "top-tracker.h"
+#include "prefix-matcher.h"
 #include <sstream>
 #include <string>
 
 
+// Formats a counter for display
+typedef QString (*QueueFormatter)(quint64);
+
+// One column the queue table is able to show
+struct QueueColumn {
+    QueueProperty   property;
+    const char*     header;
+    int             alignment;
+    QueueFormatter  format;
+    bool            visible;    // shown when there are no saved settings
+};
+
 class QueueTableModel : public QAbstractTableModel {
     Q_OBJECT
 
 public:
+    // which queues are shown: all of them, or the top N by some measure
+    typedef enum { TOP_OFF, TOP_MSG_DEPTH, TOP_BYTE_DEPTH, TOP_ENQUEUE_RATE } TopMode;
+
+    // a depth or rate cell's recent values, oldest first, as a QVariantList
+    enum { SparklineRole = Qt::UserRole + 1 };
+
     QueueTableModel(QObject* parent = 0);
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const;
@@ -39,46 +62,86 @@ public:
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
 
-    const qmf::Data&        selectedQueue(const QModelIndex&);
-    const qmf::Agent&       selectedQueueAgent(const QModelIndex&);
     const qmf::DataAddr&    selectedQueueDataAddr(const QModelIndex&);
     QString                 selectedQueueName(const QModelIndex&);
     QVariant                selectedQueueDepth(const QModelIndex&);
 
     void refresh(uint);
+    const QString& queueName(int row) const { return stats.name(row); }
+    int compare(int leftRow, int rightRow, int column) const;
+    size_t memoryUsage() const { return stats.memoryUsage(); }
+
+    // all the columns that can be shown, in display order
+    static int columnDescriptorCount();
+    static const QueueColumn& columnDescriptor(int);
+    bool isColumnVisible(int) const;
+    void setColumnVisible(int, bool);
+
+    void setTopQueues(TopMode, uint count);
+    TopMode topMode() const { return topQueues; }
+    // hidden management queues and queues outside the top N are not shown
+    bool isShown(int row) const {
+        return (!hideSystemQueues || !systemRows[row]) && (topQueues == TOP_OFF || top.contains(row));
+    }
+
+    static QStringList defaultSystemQueuePrefixes();
 
 public slots:
-    void addQueue(const qmf::Data&, uint);
+    void addQueues(const QueueSampleBatch&, uint);
+    void updateQueues(const QueueSampleBatch&);
     void connectionChanged(bool isConnected);
     void clear();
     void toggleSystemQueues(bool);
+    void setSystemQueuePrefixes(const QStringList&);
+    void setTopQueueCount(uint);
 
 signals:
+    // a row started or stopped being shown in top N mode
+    void rowShownChanged(int row);
+    // any row may have started or stopped being shown
+    void shownRowsChanged();
+    // Scattered rows are about to be erased, or have been, in one layout
+    // change. In between the remaining rows are renumbered.
+    void rowsAboutToBeErased(const QVector<bool>& flagged);
+    void rowsErased(const QVector<bool>& flagged);
 
 protected:
 
 private:
-    QString fmtBytes(const qpid::types::Variant&) const;
-
     // the data for the queues in the display list
-    typedef QList<qmf::Data> DataList;
-    DataList    dataList;
-
-    // the columns that are to be displayed
-    struct Column {
-        std::string     name;
-        QString         header;
-        QVariant        alignment;
-        std::string     format;
-
-        Column(const std::string& _n, const char* _h, const QVariant& _a, const std::string& _f) :
-            name(_n), header(_h), alignment(_a), format(_f) {}
-    };
-    typedef QList<Column> QueueColumnList;
-    QueueColumnList queueColumns;
+    QueueStats  stats;
+    // interned QMF object name -> row in stats
+    QHash<quint32, int> rowIndex;
+    int findRow(const QString& objectName) const;
+
+    // formatted cells, QP_COUNT per row. A bit in cached is set for each
+    // cell that is still valid, and cleared when its counter changes.
+    mutable QVector<QString> cells;
+    mutable QVector<quint32> cached;
+    const QString& cell(int row, const QueueColumn&) const;
+
+    // the columns that are to be displayed, as descriptor indexes
+    QVector<int> queueColumns;
+    void loadColumns();
+    void saveColumns();
+
+    // the rows shown in top N mode
+    TopMode     topQueues;
+    TopTracker  top;
+    quint64 topKey(int row) const;
+    std::vector<quint64> topKeys() const;
+    void emitTopChanges();
+
+    // management queues are found once, when a queue is first added
     bool hideSystemQueues;
-    bool isSystemQueue(const qmf::Data&);
-    QStringList managementQueues;
+    bool isSystemQueue(const QString&) const;
+    PrefixMatcher systemQueues;
+    QVector<bool> systemRows;
+    void shownChanged();
+
+    void reindex();
+    void emitChanged(int, quint32);
+    void removeFlagged(const QVector<bool>&);
 };
 
 std::ostream& operator<<(std::ostream& out, const qmf::Data& queue);
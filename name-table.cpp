@@ -0,0 +1,79 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "name-table.h"
+
+quint32 NameTable::intern(const QString& text)
+{
+    QHash<QString, quint32>::const_iterator found = ids.find(text);
+    if (found != ids.end()) {
+        ++refs[found.value()];
+        return found.value();
+    }
+
+    quint32 id;
+    if (!freeIds.isEmpty()) {
+        id = freeIds.last();
+        freeIds.pop_back();
+        strings[id] = text;
+        refs[id] = 1;
+    } else {
+        id = strings.size();
+        strings.append(text);
+        refs.append(1);
+    }
+    // the key shares its characters with strings[id]
+    ids.insert(strings[id], id);
+    return id;
+}
+
+void NameTable::release(quint32 id)
+{
+    if (--refs[id] > 0)
+        return;
+    ids.remove(strings[id]);
+    strings[id] = QString();
+    freeIds.append(id);
+}
+
+quint32 NameTable::find(const QString& text) const
+{
+    QHash<QString, quint32>::const_iterator found = ids.find(text);
+    return found == ids.end() ? (quint32)NO_NAME : found.value();
+}
+
+void NameTable::clear()
+{
+    strings.clear();
+    refs.clear();
+    ids.clear();
+    freeIds.clear();
+}
+
+// The characters of each string, its slot and its hash entry
+size_t NameTable::memoryUsage() const
+{
+    size_t bytes = strings.size() * (sizeof(QString) + sizeof(quint32)) +
+                   freeIds.size() * sizeof(quint32) +
+                   ids.size() * (sizeof(QString) + sizeof(quint32) + 2 * sizeof(void*));
+    for (QHash<QString, quint32>::const_iterator iter = ids.begin(); iter != ids.end(); iter++)
+        bytes += iter.key().size() * sizeof(QChar);
+    return bytes;
+}
@@ -0,0 +1,55 @@
+#ifndef _qe_name_table_h
+#define _qe_name_table_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+
+//
+// Interned strings. Each distinct string is stored once and named by a
+// small id, so a table of rows only has to hold the ids. Ids are
+// reference counted and reused once the last reference is released.
+//
+class NameTable {
+public:
+    enum { NO_NAME = 0xffffffff };
+
+    // the id of text, with one more reference to it
+    quint32 intern(const QString& text);
+    void release(quint32 id);
+    // the id of text, or NO_NAME if it isn't in the table
+    quint32 find(const QString& text) const;
+    const QString& text(quint32 id) const { return strings[id]; }
+
+    int size() const { return ids.size(); }
+    void clear();
+    size_t memoryUsage() const;
+
+private:
+    QVector<QString>        strings;
+    QVector<quint32>        refs;
+    QHash<QString, quint32> ids;
+    QVector<quint32>        freeIds;
+};
+
+#endif
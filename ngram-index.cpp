@@ -0,0 +1,155 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "ngram-index.h"
+#include "row-runs.h"
+#include <algorithm>
+#include <iterator>
+
+void NGramIndex::clear()
+{
+    postings.clear();
+    count = 0;
+}
+
+// The distinct trigrams of text, case folded and packed into a key
+void NGramIndex::grams(const QString& text, QVector<quint64>& keys)
+{
+    keys.clear();
+    QString folded = text.toCaseFolded();
+    const QChar* chars = folded.unicode();
+    for (int idx = 0; idx + N <= folded.size(); idx++) {
+        quint64 key = 0;
+        for (int ch = 0; ch < N; ch++)
+            key = (key << 16) | chars[idx + ch].unicode();
+        keys.append(key);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+// Rows are nearly always added at the end, where a posting list only has
+// to be appended to
+void NGramIndex::insertRows(int first, const QVector<QString>& names)
+{
+    int added = names.size();
+    if (added == 0)
+        return;
+
+    if (first < count) {
+        for (PostingMap::iterator list = postings.begin(); list != postings.end(); list++)
+            for (QVector<int>::iterator row = list->begin(); row != list->end(); row++)
+                if (*row >= first)
+                    *row += added;
+    }
+    count += added;
+
+    QVector<quint64> keys;
+    for (int idx = 0; idx < added; idx++) {
+        int row = first + idx;
+        grams(names[idx], keys);
+        for (QVector<quint64>::const_iterator key = keys.begin(); key != keys.end(); key++) {
+            QVector<int>& rows(postings[*key]);
+            if (rows.isEmpty() || rows.last() < row)
+                rows.append(row);
+            else
+                rows.insert(std::lower_bound(rows.begin(), rows.end(), row), row);
+        }
+    }
+}
+
+// Drop the rows from every list and close up the numbers after them
+void NGramIndex::removeRows(int first, int last)
+{
+    int removed = last - first + 1;
+    for (PostingMap::iterator list = postings.begin(); list != postings.end(); ) {
+        QVector<int>& rows(list.value());
+        int kept = 0;
+        for (int idx = 0; idx < rows.size(); idx++) {
+            int row = rows[idx];
+            if (row >= first && row <= last)
+                continue;
+            rows[kept++] = row > last ? row - removed : row;
+        }
+        if (kept == 0) {
+            list = postings.erase(list);
+        } else {
+            rows.resize(kept);
+            ++list;
+        }
+    }
+    count -= removed;
+}
+
+// Drop the flagged rows from every list in one pass over each, renumbering
+// the rest
+void NGramIndex::removeFlagged(const QVector<bool>& flagged)
+{
+    std::vector<int> kept(keptRows(flagged));
+    for (PostingMap::iterator list = postings.begin(); list != postings.end(); ) {
+        QVector<int>& rows(list.value());
+        int left = 0;
+        for (int idx = 0; idx < rows.size(); idx++) {
+            if (kept[rows[idx]] >= 0)
+                rows[left++] = kept[rows[idx]];
+        }
+        if (left == 0) {
+            list = postings.erase(list);
+        } else {
+            rows.resize(left);
+            ++list;
+        }
+    }
+    count = flagged.count(false);
+}
+
+// Intersect the posting lists, shortest first
+void NGramIndex::candidates(const QString& text, QVector<int>& rows) const
+{
+    rows.clear();
+
+    QVector<quint64> keys;
+    grams(text, keys);
+    if (keys.isEmpty()) {
+        rows.reserve(count);
+        for (int row = 0; row < count; row++)
+            rows.append(row);
+        return;
+    }
+
+    QVector<const QVector<int>*> lists;
+    for (QVector<quint64>::const_iterator key = keys.begin(); key != keys.end(); key++) {
+        PostingMap::const_iterator list = postings.find(*key);
+        if (list == postings.end())
+            return;
+        lists.append(&list.value());
+    }
+    for (int idx = 1; idx < lists.size(); idx++)
+        for (int prev = idx; prev > 0 && lists[prev]->size() < lists[prev - 1]->size(); prev--)
+            std::swap(lists[prev], lists[prev - 1]);
+
+    rows = *lists[0];
+    for (int idx = 1; idx < lists.size() && !rows.isEmpty(); idx++) {
+        QVector<int> both;
+        std::set_intersection(rows.begin(), rows.end(), lists[idx]->begin(), lists[idx]->end(),
+                              std::back_inserter(both));
+        rows = both;
+    }
+}
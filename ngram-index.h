@@ -0,0 +1,61 @@
+#ifndef _qe_ngram_index_h
+#define _qe_ngram_index_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+
+//
+// An index of the trigrams in a list of names, for finding the names that
+// contain some text without looking at every one. Each trigram of the
+// case folded names has a sorted list of the rows it appears in; the rows
+// that can hold a piece of text are those in the lists of all its
+// trigrams. Rows are kept in step with the model as they come and go.
+//
+class NGramIndex {
+public:
+    enum { N = 3 };
+
+    NGramIndex() : count(0) {}
+
+    void clear();
+    int size() const { return count; }
+
+    // names are inserted as rows first onwards
+    void insertRows(int first, const QVector<QString>& names);
+    void removeRows(int first, int last);
+    void removeFlagged(const QVector<bool>& flagged);
+
+    // The rows, in order, whose names may contain text. They still have to
+    // be checked. Text shorter than N gives every row.
+    void candidates(const QString& text, QVector<int>& rows) const;
+
+private:
+    typedef QHash<quint64, QVector<int> > PostingMap;
+
+    PostingMap  postings;
+    int         count;
+
+    static void grams(const QString& text, QVector<quint64>& keys);
+};
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "offline-source.h"
+
+QueueSampleBatch OfflineSource::queues() const
+{
+    QHash<QString, QString> properties;
+    const SnapshotFields& fields(reader.queueProperties());
+    for (SnapshotFields::const_iterator iter = fields.begin(); iter != fields.end(); iter++)
+        properties.insert(iter->first, iter->second);
+
+    std::vector<QueueSample>* samples = new std::vector<QueueSample>();
+    samples->push_back(QueueSample::fromText(reader.queueName(), properties, 0));
+    return QueueSampleBatch(samples);
+}
+
+QList<quint32> OfflineSource::messageIds() const
+{
+    QList<quint32> ids;
+    ids.reserve(reader.messageCount());
+    for (int idx = 0; idx < reader.messageCount(); idx++)
+        ids.append(idx);
+    return ids;
+}
+
+// The headers are laid out the way PreparedHeader::prepare() does it for
+// a broker's response, with the id the message had on the broker added
+PreparedHeaderBatch OfflineSource::headers(const QList<quint32>& ids) const
+{
+    std::string queue(reader.queueName().toStdString());
+    std::vector<PreparedHeader>* batch = new std::vector<PreparedHeader>();
+    batch->reserve(ids.size());
+
+    SnapshotMessage message;
+    for (QList<quint32>::const_iterator id = ids.begin(); id != ids.end(); id++) {
+        if (!reader.message(*id, message))
+            continue;
+
+        batch->push_back(PreparedHeader());
+        PreparedHeader& header(batch->back());
+        header.queue = reader.queueName();
+        header.id = *id;
+        header.messageId = QString::number(*id).toStdString();
+        header.args["name"] = queue;
+        header.args["id"] = (uint32_t)*id;
+        header.summary[""] = QString(header.messageId.c_str());
+
+        header.addField("sequence", message.messageId);
+        for (SnapshotFields::const_iterator field = message.arguments.begin();
+             field != message.arguments.end(); field++)
+            header.addField(field->first.toStdString(), field->second);
+        header.summaryText = headerText(header.summary, true);
+    }
+    return PreparedHeaderBatch(batch);
+}
+
+QString OfflineSource::body(const qpid::types::Variant::Map& args) const
+{
+    qpid::types::Variant::Map::const_iterator iter = args.find("id");
+    if (iter == args.end())
+        return QString();
+    return reader.body(iter->second.asUint32());
+}
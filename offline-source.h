@@ -0,0 +1,56 @@
+#ifndef _qe_offline_source_h
+#define _qe_offline_source_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include <QList>
+#include <QString>
+#include "snapshot-reader.h"
+#include "queue-stats.h"
+#include "header-preparer.h"
+
+//
+// Serves a queue export, XML or binary, to the queue table and the header
+// tree in place of the broker. A message's id is its position in the
+// file, and its header and body are only read when they are asked for.
+//
+class OfflineSource {
+public:
+    bool open(const QString& path) { return reader.open(path); }
+    void close() { reader.close(); }
+    bool isOpen() const { return reader.isOpen(); }
+    QString errorString() const { return reader.errorString(); }
+
+    const QString& queueName() const { return reader.queueName(); }
+
+    // the queue's row for the queue table
+    QueueSampleBatch queues() const;
+    // every message's id, in file order
+    QList<quint32> messageIds() const;
+    PreparedHeaderBatch headers(const QList<quint32>& ids) const;
+    // args are those of a header from headers()
+    QString body(const qpid::types::Variant::Map& args) const;
+
+private:
+    SnapshotReader reader;
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "prefix-matcher.h"
+#include <algorithm>
+
+PrefixMatcher::PrefixMatcher() : nodes(1), count(0)
+{
+}
+
+PrefixMatcher::PrefixMatcher(const QStringList& list) : nodes(1), count(0)
+{
+    for (QStringList::const_iterator prefix = list.begin(); prefix != list.end(); prefix++)
+        add(*prefix);
+}
+
+// An empty prefix would match everything, so it is ignored
+void PrefixMatcher::add(const QString& prefix)
+{
+    if (prefix.isEmpty())
+        return;
+
+    int node = 0;
+    for (int idx = 0; idx < prefix.size(); idx++) {
+        ushort ch = prefix[idx].unicode();
+        int next = child(node, ch);
+        if (next < 0) {
+            next = nodes.size();
+            nodes.push_back(Node());
+            std::vector<Edge>& edges(nodes[node].edges);
+            edges.insert(std::lower_bound(edges.begin(), edges.end(), Edge(ch, 0)), Edge(ch, next));
+        }
+        node = next;
+    }
+    nodes[node].last = true;
+    patterns.append(prefix);
+    ++count;
+}
+
+void PrefixMatcher::clear()
+{
+    nodes.assign(1, Node());
+    patterns.clear();
+    count = 0;
+}
+
+bool PrefixMatcher::matches(const QString& name) const
+{
+    const QChar* chars = name.unicode();
+    int node = 0;
+    for (int idx = 0; idx < name.size(); idx++) {
+        node = child(node, chars[idx].unicode());
+        if (node < 0)
+            return false;
+        if (nodes[node].last)
+            return true;
+    }
+    return false;
+}
+
+int PrefixMatcher::child(int node, ushort ch) const
+{
+    const std::vector<Edge>& edges(nodes[node].edges);
+    std::vector<Edge>::const_iterator edge = std::lower_bound(edges.begin(), edges.end(), Edge(ch, 0));
+    if (edge == edges.end() || edge->first != ch)
+        return -1;
+    return edge->second;
+}
+
+QStringList PrefixMatcher::parse(const QString& text)
+{
+    QStringList prefixes;
+    QStringList parts = text.split(',', QString::SkipEmptyParts);
+    for (QStringList::const_iterator part = parts.begin(); part != parts.end(); part++) {
+        QString prefix = part->trimmed();
+        if (!prefix.isEmpty())
+            prefixes.append(prefix);
+    }
+    return prefixes;
+}
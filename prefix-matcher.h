@@ -0,0 +1,64 @@
+#ifndef _qe_prefix_matcher_h
+#define _qe_prefix_matcher_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <QString>
+#include <QStringList>
+#include <vector>
+#include <utility>
+
+//
+// Tells whether a name starts with any of a set of prefixes. The prefixes
+// are kept in a trie, so a match costs one step per character of the
+// name however many prefixes there are.
+//
+class PrefixMatcher {
+public:
+    PrefixMatcher();
+    explicit PrefixMatcher(const QStringList& prefixes);
+
+    void add(const QString& prefix);
+    void clear();
+    bool isEmpty() const { return count == 0; }
+    const QStringList& prefixes() const { return patterns; }
+
+    bool matches(const QString& name) const;
+
+    // split a comma separated list of prefixes
+    static QStringList parse(const QString&);
+
+private:
+    // an edge is a character and the node it leads to
+    typedef std::pair<ushort, int> Edge;
+    struct Node {
+        std::vector<Edge>   edges;      // sorted by character
+        bool                last;       // a prefix ends here
+        Node() : last(false) {}
+    };
+
+    std::vector<Node>   nodes;          // nodes[0] is the root
+    QStringList         patterns;
+    int                 count;
+
+    int child(int node, ushort ch) const;
+};
+
+#endif
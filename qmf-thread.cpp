@@ -22,6 +22,7 @@
 #include <qmf/Query.h>
 #include <qmf/engine/Value.h>
 #include <qmf/DataAddr.h>
+#include <qmf/SchemaId.h>
 
 #include <iostream>
 #include <string>
@@ -29,10 +30,56 @@
 using std::cout;
 using std::endl;
 
+// How long to wait for the broker to answer a method call before giving up on it
+static const qint64 CALL_TIMEOUT = 30000;
+// How long nextEvent may block before pending commands are looked at
+static const qint64 EVENT_WAIT = 100;
+// Header responses are handed to the preparers in batches of up to this
+// many, or after this long, whichever comes first
+static const size_t HEADER_BATCH = 64;
+static const qint64 HEADER_BATCH_WAIT = 20;
+// Pushed queue statistics are passed to the GUI at most this often
+static const qint64 STATS_BATCH_WAIT = 100;
+// Most queueGetMessageBody calls an export may have outstanding
+static const uint EXPORT_WINDOW = 16;
+
+// Returns a number that changes whenever messages go through a queue
+static quint64 queueActivity(const QueueSample& queue)
+{
+    quint64 activity = 0;
+    if (queue.has(QP_MSG_ENQUEUES))
+        activity += queue.values[QP_MSG_ENQUEUES];
+    if (queue.has(QP_MSG_DEQUEUES))
+        activity += queue.values[QP_MSG_DEQUEUES] * 31;
+    return activity;
+}
+
+// Convert all the queues in a query response or subscription update
+static std::vector<QueueSample>* queueSamples(const qmf::ConsoleEvent& event, qint64 now)
+{
+    uint32_t pcount = event.getDataCount();
+    std::vector<QueueSample>* samples = new std::vector<QueueSample>();
+    samples->reserve(pcount);
+    for (uint32_t idx = 0; idx < pcount; idx++)
+        samples->push_back(QueueSample::fromData(event.getData(idx), now));
+    return samples;
+}
+
 QmfThread::QmfThread(QObject* parent) :
-    QThread(parent), cancelled(false), connected(false)
+    QThread(parent), cancelled(false), connected(false),
+    pausedRefreshes(false), expiredCalls(0), headerWindow(100), headersInFlight(0), bodiesInFlight(0),
+    windowedHeaders(false), headerBatchStarted(0), foreignCalls(0), queueListCorrelator(0), statsCorrelator(0),
+    queueListPending(false), queueListStarted(0), idListPending(false),
+    queueListActivity(0), lastQueueListActivity(0), watchedActivity(0),
+    statsPushed(false), statsBatchStarted(0)
 {
-    // Intentionally Left Blank
+    clock.start();
+    preparers.setMaxThreadCount(1);
+
+    // the queue list is the most expensive query, back it off the furthest
+    scheduler.setInterval(RefreshScheduler::QUEUE_LIST, 2000, 30000);
+    scheduler.setInterval(RefreshScheduler::HEADERS, 1000, 10000);
+    scheduler.setInterval(RefreshScheduler::STATISTICS, 1000, 5000);
 }
 
 
@@ -45,14 +92,14 @@ void QmfThread::cancel()
 void QmfThread::connect_localhost()
 {
     QMutexLocker locker(&lock);
-    command_queue.push_back(Command(true, "localhost", "", "{strict-security:False}"));
+    command_queue.push_back(Command(CMD_CONNECT, "localhost", "", "{strict-security:False}"));
     cond.wakeOne();
 }
 
 void QmfThread::connect_url(const QString& url, const QString& conn_options, const QString& qmf_options)
 {
     QMutexLocker locker(&lock);
-    command_queue.push_back((Command(true, url.toStdString(),
+    command_queue.push_back((Command(CMD_CONNECT, url.toStdString(),
                                      conn_options.toStdString(),
                                      qmf_options.toStdString())));
     cond.wakeOne();
@@ -61,7 +108,7 @@ void QmfThread::connect_url(const QString& url, const QString& conn_options, con
 void QmfThread::disconnect()
 {
     QMutexLocker locker(&lock);
-    command_queue.push_back(Command(false, "", "", ""));
+    command_queue.push_back(Command(CMD_DISCONNECT));
     cond.wakeOne();
 }
 
@@ -72,12 +119,25 @@ void QmfThread::run()
     while(true) {
         if (connected) {
             qmf::ConsoleEvent event;
-            qmf::Data data;
             uint32_t pcount;
             std::string s;
             qpid::types::Variant::Map args;
 
-            if (sess.nextEvent(event, qpid::messaging::Duration::SECOND * 2)) {
+            // wake up in time for the next scheduled refresh
+            qint64 wait = EVENT_WAIT;
+            if (!headerResponses.empty())
+                wait = HEADER_BATCH_WAIT;
+            {
+                // due timers are left due while refreshes can't be made,
+                // there is nothing to wake up early for
+                QMutexLocker locker(&lock);
+                qint64 next = scheduler.msecsUntilNext(clock.elapsed());
+                if (!pausedRefreshes && brokerData.isValid() && next >= 0 && next < wait)
+                    wait = next;
+            }
+
+            bool gotEvent = sess.nextEvent(event, qpid::messaging::Duration::MILLISECOND * wait);
+            if (gotEvent) {
                 //
                 // Process the event
                 //
@@ -93,8 +153,13 @@ void QmfThread::run()
                         if (pcount == 1)
                             brokerData = event.getData(0);
 
-                        // get the queue objects for this broker
-                        agent.queryAsync(qmf::Query(qmf::QUERY_OBJECT, "queue", "org.apache.qpid.broker"));
+                        // get the queue objects for this broker, and keep them up to date
+                        {
+                            QMutexLocker locker(&lock);
+                            scheduler.start(RefreshScheduler::QUEUE_LIST, clock.elapsed());
+                        }
+                        // and ask the broker to push the queue statistics to us
+                        subscribeQueueStats();
                     }
                     break;
 
@@ -103,57 +168,101 @@ void QmfThread::run()
                     break;
 
                 case qmf::CONSOLE_QUERY_RESPONSE :
-                    // Handle the query response from the QUERY_OBJECT for queue
-                    // Currently, this is the only async query called
-                    pcount = event.getDataCount();
-                    for (uint32_t idx = 0; idx < pcount; idx++) {
-                        emit addQueue(event.getData(idx), event.getCorrelator());
+                    // queries made for a callback, the rest are queue lists
+                    // and statistics
+                    {
+                        CallbackPtr cb(takeCallback(event.getCorrelator()));
+                        if (cb)
+                            cb->respond(*this, event);
+                        else
+                            gotQueues(event);
                     }
-                    if (event.isFinal())
-                        emit doneAddingQueues(event.getCorrelator());
-                    else
-                        pcount++;
+                    break;
+
+                case qmf::CONSOLE_SUBSCRIBE_ADD :
+                    setStatsPushed(true);
+                    break;
+
+                case qmf::CONSOLE_SUBSCRIBE_UPDATE :
+                    gotQueueStats(event);
+                    break;
+
+                case qmf::CONSOLE_SUBSCRIBE_DEL :
+                    // the broker stopped pushing, go back to polling
+                    setStatsPushed(false);
+                    break;
+
+                case qmf::CONSOLE_EVENT :
+                    gotAgentEvent(event);
                     break;
 
                 case qmf::CONSOLE_METHOD_RESPONSE :
                     callCallback(event);
+                    // a header or body call may have completed, keep the windows full
+                    fillHeaderWindow();
+                    fillExportWindow();
                    break;
                 case qmf::CONSOLE_EXCEPTION :
-                   if (event.getDataCount() > 0) {
-                       data = event.getData(0);
-
-                       s = data.getProperty("error_text").asString();
-                       emit qmfError(QString(s.c_str()));
+                   if (event.getDataCount() > 0)
+                       s = event.getData(0).getProperty("error_text").asString();
+                   // a failed method call will never get a response
+                   {
+                       CallbackPtr cb(takeCallback(event.getCorrelator()));
+                       if (cb)
+                           cb->failed(*this, QString(s.c_str()));
                    }
+                   // nor will a failed queue list query finish
+                   if (event.getCorrelator() == queueListCorrelator) {
+                       QMutexLocker locker(&lock);
+                       queueListPending = false;
+                   }
+                   fillHeaderWindow();
+                   fillExportWindow();
+                   if (event.getDataCount() > 0)
+                       emit qmfError(QString(s.c_str()));
                    break;
 
                 default :
                     break;
                 }
 
-            } else {
-                // update the list of queues every second
-                if (!pausedRefreshes) {
-                    sess.getConnectedBrokerAgent().queryAsync(qmf::Query(qmf::QUERY_OBJECT, "queue", "org.apache.qpid.broker"));
-                }
             }
 
+            // pass on the headers that have arrived, all of them once
+            // the responses have stopped coming
+            flushHeaderResponses(!gotEvent);
+            flushQueueStats(!gotEvent);
+
+            // start whichever refreshes are due
+            runTimers();
+
+            // forget about any calls the broker never answered
+            expireCallbacks();
+
+            // run everything the GUI has asked for since the last pass. The
+            // broker methods can't be called until the broker object has
+            // arrived, those commands are kept until it has.
+            command_queue_t commands;
+            command_queue_t waiting;
             {
                 QMutexLocker locker(&lock);
-                if (command_queue.size() > 0) {
-                    Command command(command_queue.front());
-                    command_queue.pop_front();
-                    if (!command.connect) {
-                        emit connectionStatusChanged("QMF Session Closing...");
-                        sess.close();
-                        emit connectionStatusChanged("Closing...");
-                        conn.close();
-                        emit connectionStatusChanged("Closed");
-                        connected = false;
-                        emit isConnected(false);
-                    }
-                }
+                commands.swap(command_queue);
+            }
+            for (command_queue_t::const_iterator iter = commands.begin();
+                 connected && iter != commands.end(); iter++) {
+                if (iter->type != CMD_DISCONNECT && !brokerData.isValid())
+                    waiting.push_back(*iter);
+                else
+                    runCommand(*iter);
+            }
+            if (connected && !waiting.empty()) {
+                QMutexLocker locker(&lock);
+                command_queue.insert(command_queue.begin(), waiting.begin(), waiting.end());
             }
+
+            // start the bodies of any new export
+            if (connected)
+                fillExportWindow();
         } else {
             QMutexLocker locker(&lock);
             if (command_queue.size() == 0)
@@ -161,7 +270,7 @@ void QmfThread::run()
             if (command_queue.size() > 0) {
                 Command command(command_queue.front());
                 command_queue.pop_front();
-                if (command.connect & !connected)
+                if (command.type == CMD_CONNECT && !connected)
                     try {
                         emit connectionStatusChanged("QMF connection opening...");
 
@@ -185,6 +294,16 @@ void QmfThread::run()
                         line << "QMF Session Failed: " << ex.what();
                         emit connectionStatusChanged(line.str().c_str());
                     }
+                // a broker call asked for with no connection would never be
+                // answered, let the user know it wasn't made
+                if (command.type == CMD_REMOVE_MESSAGE || command.type == CMD_GET_BODY ||
+                    command.type == CMD_PURGE)
+                    emit qmfError("Not connected to a broker");
+                if (command.type == CMD_GET_QUEUE) {
+                    uint job = command.args.find("job")->second.asUint32();
+                    if (exportJobs.contains(job))
+                        emit exportFailed(job, -1, "Not connected to a broker");
+                }
             }
         }
 
@@ -196,115 +315,778 @@ void QmfThread::run()
             break;
         }
     }
+
+    // the preparers signal through this object
+    preparers.waitForDone();
+}
+
+// Carry out a command posted by the GUI thread while connected. All but
+// CMD_DISCONNECT need the broker object.
+void QmfThread::runCommand(const Command& command)
+{
+    switch (command.type) {
+    case CMD_DISCONNECT:
+        // nothing outstanding will be answered after the close
+        {
+            QMutexLocker locker(&lock);
+            callbacks.clear();
+            deadlines.clear();
+            header_queue.clear();
+            headersInFlight = 0;
+            body_queue.clear();
+            bodiesInFlight = 0;
+            headerQueue.clear();
+            knownIds.clear();
+            requestedIds.clear();
+            headerResponses.clear();
+            statsUpdates.clear();
+            // the export jobs won't get the rest of their bodies
+            for (QSet<uint>::const_iterator job = exportJobs.begin(); job != exportJobs.end(); ++job)
+                emit exportFailed(*job, -1, "The connection was closed");
+            exportJobs.clear();
+            for (int t = 0; t < RefreshScheduler::TIMER_COUNT; t++)
+                scheduler.stop((RefreshScheduler::Timer)t);
+            queueListPending = false;
+            idListPending = false;
+        }
+        if (statsSubscription.isValid()) {
+            statsSubscription.cancel();
+            statsSubscription = qmf::Subscription();
+        }
+        setStatsPushed(false);
+        // the next connection has its own broker object
+        brokerData = qmf::Data();
+
+        emit connectionStatusChanged("QMF Session Closing...");
+        sess.close();
+        emit connectionStatusChanged("Closing...");
+        conn.close();
+        emit connectionStatusChanged("Closed");
+        connected = false;
+        emit isConnected(false);
+        break;
+
+    case CMD_GET_HEADER_IDS:
+        {
+            // start from scratch when asked to, or when the queue changes
+            std::string queue(command.args.find("name")->second.asString());
+            if (command.args.find("reset")->second.asBool() || queue != headerQueue) {
+                QMutexLocker locker(&lock);
+                headerQueue = queue;
+                knownIds.clear();
+                header_queue.clear();
+                requestedIds.clear();
+            }
+        }
+        requestHeaderIds(command.args);
+        break;
+
+    case CMD_WATCH:
+        // a new queue was selected, refresh its messages and statistics
+        // straight away and keep refreshing them quickly
+        {
+            QMutexLocker locker(&lock);
+            headerQueue = command.args.find("name")->second.asString();
+            knownIds.clear();
+            header_queue.clear();
+            requestedIds.clear();
+            watchedAddr = command.dataAddr;
+            watchedActivity = 0;
+            idListPending = false;
+            scheduler.start(RefreshScheduler::HEADERS, clock.elapsed());
+            scheduler.start(RefreshScheduler::STATISTICS, clock.elapsed());
+        }
+        break;
+
+    case CMD_GET_HEADERS:
+        // the rows the GUI is showing now replace any it asked for before
+        // that haven't been requested yet
+        {
+            QMutexLocker locker(&lock);
+            if (command.args.find("name")->second.asString() != headerQueue)
+                break;
+            header_queue_t wanted;
+            const qpid::types::Variant::List& ids(command.args.find("ids")->second.asList());
+            for (qpid::types::Variant::List::const_iterator iter = ids.begin(); iter != ids.end(); iter++) {
+                uint32_t id = iter->asUint32();
+                if (knownIds.contains(id) && !requestedIds.contains(id))
+                    wanted.push_back(HeaderRequest(headerQueue, id));
+            }
+            header_queue.swap(wanted);
+        }
+        fillHeaderWindow();
+        break;
+
+    case CMD_REMOVE_MESSAGE:
+        // submit an asyncronous call to remove the message
+        // and request that the removedMessage signal be emitted when ready
+        addCallback(brokerData.getAgent(), "queueRemoveMessage", brokerData.getAddr(),
+                    new RemoveCallback(command.args));
+        break;
+
+    case CMD_GET_BODY:
+        addCallback(brokerData.getAgent(), "queueGetMessageBody", brokerData.getAddr(),
+                    new BodyCallback(command.args, command.index));
+        break;
+
+    case CMD_PURGE:
+        {
+            qpid::types::Variant::Map map;
+            map["request"] = command.args.find("request")->second;
+            addCallback(sess.getConnectedBrokerAgent(), "purge", command.dataAddr,
+                        new PurgeCallback(map, command.args.find("name")->second.asString()));
+        }
+        break;
+
+    case CMD_GET_QUEUE:
+        if (command.dataAddr.isValid())
+            addQueryCallback(brokerData.getAgent(), qmf::Query(command.dataAddr),
+                             new QueueCallback(command.args.find("job")->second.asUint32()));
+        else
+            // the export goes on without the queue's properties
+            signalExportQueue(command.args.find("job")->second.asUint32(), qmf::Data());
+        break;
+
+    case CMD_CONNECT:
+        // already connected
+        break;
+    }
+}
+
+// Make the refresh queries whose timers are due
+void QmfThread::runTimers()
+{
+    bool queueList, headers, stats;
+    qpid::types::Variant::Map map;
+    qmf::DataAddr addr;
+    qint64 now = clock.elapsed();
+    {
+        QMutexLocker locker(&lock);
+        if (pausedRefreshes || !brokerData.isValid())
+            return;
+
+        queueList = scheduler.isDue(RefreshScheduler::QUEUE_LIST, now);
+        if (queueList)
+            scheduler.fired(RefreshScheduler::QUEUE_LIST, now);
+        headers = scheduler.isDue(RefreshScheduler::HEADERS, now);
+        if (headers)
+            scheduler.fired(RefreshScheduler::HEADERS, now);
+        stats = scheduler.isDue(RefreshScheduler::STATISTICS, now);
+        if (stats)
+            scheduler.fired(RefreshScheduler::STATISTICS, now);
+        // no need to poll what the broker pushes to us
+        stats = stats && !statsPushed;
+
+        // a queue list the broker never finished doesn't hold up the
+        // refreshes for good
+        if (queueListPending && now - queueListStarted >= CALL_TIMEOUT)
+            queueListPending = false;
+
+        // don't pile up requests the broker hasn't got to yet
+        queueList = queueList && !queueListPending;
+        headers = headers && !idListPending;
+        map["name"] = headerQueue;
+        addr = watchedAddr;
+    }
+
+    if (queueList) {
+        queueListPending = true;
+        queueListStarted = now;
+        queueListActivity = 0;
+        queueListCorrelator = sess.getConnectedBrokerAgent().queryAsync(
+                    qmf::Query(qmf::QUERY_OBJECT, "queue", "org.apache.qpid.broker"));
+    }
+    if (headers)
+        requestHeaderIds(map);
+    if (stats)
+        statsCorrelator = sess.getConnectedBrokerAgent().queryAsync(qmf::Query(addr));
+}
+
+// Handle the response to a queue list or a selected queue statistics query
+void QmfThread::gotQueues(const qmf::ConsoleEvent& event)
+{
+    std::vector<QueueSample>* samples = queueSamples(event, clock.elapsed());
+    {
+        // drop the queues the user filtered out before they reach the GUI
+        QMutexLocker locker(&lock);
+        if (!includeQueues.isEmpty() || !excludeQueues.isEmpty()) {
+            size_t kept = 0;
+            for (size_t idx = 0; idx < samples->size(); idx++) {
+                if (!wantQueue((*samples)[idx]))
+                    continue;
+                if (kept != idx)
+                    (*samples)[kept] = (*samples)[idx];
+                ++kept;
+            }
+            samples->resize(kept);
+        }
+    }
+    QueueSampleBatch batch(samples);
+
+    if (event.getCorrelator() == statsCorrelator) {
+        // only one queue, it goes in with the current queue list so
+        // the queue table doesn't think the other queues are stale
+        quint64 activity = 0;
+        for (std::vector<QueueSample>::const_iterator iter = batch->begin(); iter != batch->end(); iter++)
+            activity += queueActivity(*iter);
+        if (!batch->empty()) {
+            emit addQueues(batch, queueListCorrelator);
+
+            QMutexLocker locker(&lock);
+            bool changed = activity != watchedActivity;
+            watchedActivity = activity;
+            scheduler.result(RefreshScheduler::STATISTICS, changed);
+            // messages came or went, the id list is out of date
+            if (changed)
+                scheduler.trigger(RefreshScheduler::HEADERS, clock.elapsed());
+        }
+        return;
+    }
+
+    for (std::vector<QueueSample>::const_iterator iter = batch->begin(); iter != batch->end(); iter++)
+        queueListActivity += queueActivity(*iter) + 1;
+    if (!batch->empty())
+        emit addQueues(batch, event.getCorrelator());
+    if (event.isFinal()) {
+        emit doneAddingQueues(event.getCorrelator());
+
+        QMutexLocker locker(&lock);
+        queueListPending = false;
+        scheduler.result(RefreshScheduler::QUEUE_LIST, queueListActivity != lastQueueListActivity);
+        lastQueueListActivity = queueListActivity;
+    }
+}
+
+// Ask the broker agent to push queue statistics as they change. Agents
+// that don't support subscriptions are polled instead.
+void QmfThread::subscribeQueueStats()
+{
+    try {
+        statsSubscription = sess.subscribe(qmf::Query(qmf::QUERY_OBJECT, "queue", "org.apache.qpid.broker"));
+    } catch (std::exception&) {
+        statsSubscription = qmf::Subscription();
+    }
+    setStatsPushed(statsSubscription.isValid() && statsSubscription.isActive());
+}
+
+// Switch between having the statistics pushed and polling for them
+void QmfThread::setStatsPushed(bool pushed)
+{
+    QMutexLocker locker(&lock);
+    statsPushed = pushed;
+    if (pushed) {
+        // the full queue list is then only needed to find new and deleted
+        // queues, and the broker tells us about those too
+        scheduler.setInterval(RefreshScheduler::QUEUE_LIST, 10000, 60000);
+    } else {
+        scheduler.setInterval(RefreshScheduler::QUEUE_LIST, 2000, 30000);
+    }
+}
+
+// Pushed queue statistics have arrived. Each update only carries the
+// values that changed. They are collected and passed on by
+// flushQueueStats().
+void QmfThread::gotQueueStats(const qmf::ConsoleEvent& event)
+{
+    uint32_t pcount = event.getDataCount();
+    qint64 now = clock.elapsed();
+    if (statsUpdates.empty())
+        statsBatchStarted = now;
+    for (uint32_t idx = 0; idx < pcount; idx++) {
+        QueueSample sample(QueueSample::fromData(event.getData(idx), now));
+
+        QMutexLocker locker(&lock);
+        if (!wantQueue(sample))
+            continue;
+        statsUpdates.push_back(sample);
+
+        // speed up the message id refresh when the selected queue changes
+        if (watchedAddr.isValid() && sample.addr.getName() == watchedAddr.getName()) {
+            quint64 activity = queueActivity(sample);
+            if (activity != 0 && activity != watchedActivity) {
+                watchedActivity = activity;
+                scheduler.trigger(RefreshScheduler::HEADERS, clock.elapsed());
+            }
+        }
+    }
+}
+
+// Pass the pushed updates collected so far to the GUI in one signal
+void QmfThread::flushQueueStats(bool force)
+{
+    if (statsUpdates.empty())
+        return;
+    if (!force && clock.elapsed() - statsBatchStarted < STATS_BATCH_WAIT)
+        return;
+
+    std::vector<QueueSample>* batch = new std::vector<QueueSample>();
+    batch->swap(statsUpdates);
+    emit updateQueues(QueueSampleBatch(batch));
+}
+
+// The broker raised an event. Queues coming and going are the only ones
+// of interest, they make the queue list out of date.
+void QmfThread::gotAgentEvent(const qmf::ConsoleEvent& event)
+{
+    for (uint32_t idx = 0; idx < event.getDataCount(); idx++) {
+        std::string name(event.getData(idx).getSchemaId().getName());
+        if (name == "queueDeclare" || name == "queueDelete") {
+            QMutexLocker locker(&lock);
+            scheduler.trigger(RefreshScheduler::QUEUE_LIST, clock.elapsed());
+            break;
+        }
+    }
+}
+
+// QMF calls are only made from run(). Count, and complain about in
+// debug builds, any that are made from another thread.
+void QmfThread::checkThread(const char* what)
+{
+    if (QThread::currentThread() != this) {
+        foreignCalls.fetchAndAddRelaxed(1);
+#ifndef QT_NO_DEBUG
+        qWarning("QmfThread: %s called outside the QMF thread", what);
+#endif
+    }
+}
+
+int QmfThread::foreignThreadCallCount() const
+{
+    return foreignCalls;
 }
 
 // Call an async method
 // Remember the correlator for the call and associate it
-// with the args used to make the call and a signal that
-// will be emitted when the call completes.
+// with the callback that will handle the response.
 void QmfThread::addCallback(qmf::Agent agent, const std::string& method,
-                            const qpid::types::Variant::Map& args,
                             const qmf::DataAddr& dataAddr,
-                            const std::string &signal,
-                            const QModelIndex& index)
+                            Callback* callback)
 {
+    CallbackPtr cb(callback);
+    checkThread(method.c_str());
     QMutexLocker locker(&lock);
 
-    callback_queue.push_back(Callback(signal, args, index));
-    callback_queue.back().correlator = agent.callMethodAsync(method, args, dataAddr);
+    rememberCallback(agent.callMethodAsync(method, cb->args, dataAddr), cb);
+}
+
+// Make an asynchronous query whose response goes to a callback
+void QmfThread::addQueryCallback(qmf::Agent agent, const qmf::Query& query, Callback* callback)
+{
+    CallbackPtr cb(callback);
+    checkThread("query");
+    QMutexLocker locker(&lock);
+
+    rememberCallback(agent.queryAsync(query), cb);
+}
+
+// The caller holds lock
+void QmfThread::rememberCallback(uint32_t correlator, const CallbackPtr& cb)
+{
+    cb->deadline = clock.elapsed() + CALL_TIMEOUT;
+    callbacks.insert(correlator, cb);
+    deadlines.push_back(std::make_pair(cb->deadline, correlator));
 
     cond.wakeOne();
 }
 
+// Remove the callback for a correlator from the table and release its
+// slot in the header window. Returns an empty pointer if there is none.
+QmfThread::CallbackPtr QmfThread::takeCallback(uint32_t correlator)
+{
+    QMutexLocker locker(&lock);
+
+    CallbackPtr cb(callbacks.take(correlator));
+    if (cb && cb->isHeaderCall())
+        --headersInFlight;
+    if (cb && cb->isExportCall())
+        --bodiesInFlight;
+    return cb;
+}
+
 // Called when a qmf::CONSOLE_METHOD_RESPONSE type event comes in.
 // Find the event correlator and call the associated function
 void QmfThread::callCallback(const qmf::ConsoleEvent& event)
+{
+    CallbackPtr cb(takeCallback(event.getCorrelator()));
+    if (cb)
+        cb->respond(*this, event);
+}
+
+// Drop the calls whose deadline has passed. The deadline queue may still
+// hold entries for calls that were already answered; those are skipped.
+void QmfThread::expireCallbacks()
+{
+    std::deque<CallbackPtr> expired;
+    qint64 now = clock.elapsed();
+    {
+        QMutexLocker locker(&lock);
+        while (!deadlines.empty() && deadlines.front().first <= now) {
+            uint32_t correlator = deadlines.front().second;
+            callback_map_t::iterator iter = callbacks.find(correlator);
+            if (iter != callbacks.end() && iter.value()->deadline == deadlines.front().first) {
+                if (iter.value()->isHeaderCall())
+                    --headersInFlight;
+                if (iter.value()->isExportCall())
+                    --bodiesInFlight;
+                expired.push_back(iter.value());
+                callbacks.erase(iter);
+            }
+            deadlines.pop_front();
+        }
+        expiredCalls += expired.size();
+    }
+
+    if (expired.size() > 0) {
+        for (std::deque<CallbackPtr>::const_iterator iter = expired.begin();
+             iter != expired.end(); iter++)
+            (*iter)->failed(*this, "The broker did not answer in time");
+        emit qmfError(QString("%1 QMF method calls timed out").arg(expired.size()));
+        // expired calls leave room in the windows
+        fillHeaderWindow();
+        fillExportWindow();
+    }
+}
+
+quint32 QmfThread::expiredCallCount() const
+{
+    QMutexLocker locker(&lock);
+    return expiredCalls;
+}
+
+void QmfThread::HeaderCallback::respond(QmfThread& thread, const qmf::ConsoleEvent& event)
+{
+    {
+        // the message was consumed after the header was asked for, and the
+        // GUI has already been told it is gone
+        QMutexLocker locker(&thread.lock);
+        thread.requestedIds.remove(args.find("id")->second.asUint32());
+        if (args.find("name")->second.asString() != thread.headerQueue ||
+            !thread.knownIds.contains(args.find("id")->second.asUint32()))
+            return;
+    }
+    if (thread.headerResponses.empty())
+        thread.headerBatchStarted = thread.clock.elapsed();
+    thread.headerResponses.push_back(std::make_pair(event, args));
+}
+
+// The header never arrived, so request it again on the next refresh. In
+// windowed mode it is requested again when its row is next shown.
+void QmfThread::HeaderCallback::failed(QmfThread& thread, const QString& error)
+{
+    Q_UNUSED(error);
+    QMutexLocker locker(&thread.lock);
+    thread.requestedIds.remove(args.find("id")->second.asUint32());
+    if (!thread.windowedHeaders && args.find("name")->second.asString() == thread.headerQueue)
+        thread.knownIds.remove(args.find("id")->second.asUint32());
+}
+
+void QmfThread::BodyCallback::respond(QmfThread& thread, const qmf::ConsoleEvent& event)
+{
+    emit thread.gotMessageBody(event, args, index);
+}
+
+void QmfThread::ExportCallback::respond(QmfThread& thread, const qmf::ConsoleEvent& event)
+{
+    QMutexLocker locker(&thread.lock);
+    if (thread.exportJobs.contains(job))
+        emit thread.gotExportBody(job, sequence, event);
+}
+
+// The job stops rather than write the message without its body
+void QmfThread::ExportCallback::failed(QmfThread& thread, const QString& error)
+{
+    thread.signalExportFailed(job, sequence, error);
+}
+
+void QmfThread::QueueCallback::respond(QmfThread& thread, const qmf::ConsoleEvent& event)
+{
+    thread.signalExportQueue(job, event.getDataCount() > 0 ? event.getData(0) : qmf::Data());
+}
+
+void QmfThread::QueueCallback::failed(QmfThread& thread, const QString& error)
+{
+    thread.signalExportFailed(job, -1, error);
+}
+
+// The export jobs are only signalled under lock and while they are
+// registered. A job that cancelExport() forgot may already be deleted.
+void QmfThread::signalExportQueue(uint job, const qmf::Data& queue)
+{
+    QMutexLocker locker(&lock);
+    if (exportJobs.contains(job))
+        emit gotExportQueue(job, queue);
+}
+
+void QmfThread::signalExportFailed(uint job, int sequence, const QString& error)
 {
     QMutexLocker locker(&lock);
+    if (exportJobs.contains(job))
+        emit exportFailed(job, sequence, error);
+}
 
-    uint32_t correlator = event.getCorrelator();
+void QmfThread::RemoveCallback::respond(QmfThread& thread, const qmf::ConsoleEvent& event)
+{
+    emit thread.removedMessage(event, args);
+}
 
-    for (callback_queue_t::iterator iter=callback_queue.begin();
-                            iter != callback_queue.end(); iter++) {
-        const Callback& cb(*iter);
-        if (cb.correlator == correlator) {
-            emitCallback(cb, event);
-            callback_queue.erase(iter);
-            break;
-        }
+void QmfThread::IdListCallback::respond(QmfThread& thread, const qmf::ConsoleEvent& event)
+{
+    thread.gotHeaderIds(event, args);
+}
+
+void QmfThread::IdListCallback::failed(QmfThread& thread, const QString& error)
+{
+    Q_UNUSED(error);
+    thread.idListPending = false;
+}
+
+void QmfThread::PurgeCallback::respond(QmfThread& thread, const qmf::ConsoleEvent& event)
+{
+    Q_UNUSED(event);
+    // the queue contents changed, get the new list of messages
+    qpid::types::Variant::Map map;
+    map["name"] = queue;
+    thread.requestHeaderIds(map);
+}
+
+// Hand the header responses collected so far to a preparer on the pool.
+// Unless forced, wait for a full batch or for the batch to get old.
+void QmfThread::flushHeaderResponses(bool force)
+{
+    if (headerResponses.empty())
+        return;
+    if (!force && headerResponses.size() < HEADER_BATCH &&
+        clock.elapsed() - headerBatchStarted < HEADER_BATCH_WAIT)
+        return;
+    preparers.start(new HeaderPreparer(this, headerResponses));
+}
+
+// Called on the preparer thread when a batch is ready for the GUI.
+// Messages that were removed while the batch was being prepared are left
+// out. The check and the signal are made under lock, the same as the
+// removals, so the GUI never gets a header after its removal.
+void QmfThread::headersPrepared(const PreparedHeaderBatch& batch)
+{
+    QMutexLocker locker(&lock);
+    size_t kept = 0;
+    for (std::vector<PreparedHeader>::const_iterator iter = batch->begin(); iter != batch->end(); iter++)
+        if (isCurrentHeader(*iter))
+            ++kept;
+    if (kept == batch->size()) {
+        emit gotMessageHeaders(batch);
+        return;
     }
-    cond.wakeOne();
+    if (kept == 0)
+        return;
+
+    std::vector<PreparedHeader>* current = new std::vector<PreparedHeader>();
+    current->reserve(kept);
+    for (std::vector<PreparedHeader>::const_iterator iter = batch->begin(); iter != batch->end(); iter++)
+        if (isCurrentHeader(*iter))
+            current->push_back(*iter);
+    emit gotMessageHeaders(PreparedHeaderBatch(current));
 }
 
-// Resolve the association between the method string stored in the callback_queue
-// and a signal function.
-void QmfThread::emitCallback(const Callback& cb, const qmf::ConsoleEvent& event)
+// The caller holds lock. True if the header is of a message that is still
+// listed on the selected queue.
+bool QmfThread::isCurrentHeader(const PreparedHeader& header) const
 {
-    if (cb.method == SIGNAL(gotMessageHeaders())) {
-        emit gotMessageHeaders(event, cb.args);
-    } else if (cb.method == SIGNAL(gotMessageBody())) {
-        emit gotMessageBody(event, cb.args, cb.index);
-    } else if (cb.method == SIGNAL(removedMessage())) {
-        emit removedMessage(event, cb.args);
+    qpid::types::Variant::Map::const_iterator name = header.args.find("name");
+    qpid::types::Variant::Map::const_iterator id = header.args.find("id");
+    return name != header.args.end() && id != header.args.end() &&
+           name->second.asString() == headerQueue && knownIds.contains(id->second.asUint32());
+}
+
+// Issue queueGetMessageHeader calls for the pending message ids until
+// headerWindow calls are outstanding or there is nothing left to request.
+void QmfThread::fillHeaderWindow()
+{
+    while (true) {
+        qpid::types::Variant::Map callMap;
+        {
+            QMutexLocker locker(&lock);
+            if (header_queue.empty() || headersInFlight >= headerWindow)
+                return;
+            const HeaderRequest& request(header_queue.front());
+            callMap["name"] = request.queue;
+            callMap["id"] = request.id;
+            requestedIds.insert(request.id);
+            header_queue.pop_front();
+            ++headersInFlight;
+        }
+        // submit an asyncronous call to get the header
+        // and request that the gotMessageHeaders signal be emitted when ready
+        addCallback(brokerData.getAgent(), "queueGetMessageHeader", brokerData.getAddr(),
+                    new HeaderCallback(callMap));
     }
 }
 
-void QmfThread::getQueueHeaders(const QString& name)
+// Ask the QMF thread to get the message ids, and then the headers,
+// of the named queue. The results are delivered by signals. Unless reset
+// is set, only the headers of messages that were not there the last time
+// are fetched.
+void QmfThread::getQueueHeaders(const QString& name, bool reset)
 {
-    static quint32 correlator = 0;
     qpid::types::Variant::Map map;
     map["name"] = name.toStdString();
-    // get the list of message header ids
-    qmf::Agent agent = brokerData.getAgent();
-    qmf::ConsoleEvent event = agent.callMethod("queueGetIdList", map, brokerData.getAddr());
+    map["reset"] = reset;
 
-    if (event.getType() == qmf::CONSOLE_METHOD_RESPONSE) {
-        ++correlator;
-        uint messageId = 0;
-        qpid::types::Variant::Map callMap;
+    QMutexLocker locker(&lock);
+    command_queue.push_back(Command(CMD_GET_HEADER_IDS, map));
+    cond.wakeOne();
+}
+
+// Make the asynchronous call for the list of message ids in a queue
+void QmfThread::requestHeaderIds(const qpid::types::Variant::Map& args)
+{
+    idListPending = true;
+    qpid::types::Variant::Map map;
+    map["name"] = args.find("name")->second;
+    addCallback(brokerData.getAgent(), "queueGetIdList", brokerData.getAddr(),
+                new IdListCallback(map));
+}
+
+// The list of message ids for a queue has arrived. Queue up header
+// requests for the new ids and tell the GUI which ids have gone away.
+void QmfThread::gotHeaderIds(const qmf::ConsoleEvent& event, const qpid::types::Variant::Map& callArgs)
+{
+    std::string queue(callArgs.find("name")->second.asString());
+    QList<quint32> removed;
+    QList<quint32> addedIds;
+    bool added = false;
+
+    idListPending = false;
+
+    // get the list of ids
+    const qpid::types::Variant::Map& args(event.getArguments());
+    qpid::types::Variant::Map::const_iterator iter = args.begin();
+    if (iter == args.end())
+        return;
+    const qpid::types::Variant::List& sublist((iter->second).asList());
 
-        callMap["name"] = name.toStdString();
-
-        // get the list of ids
-        const qpid::types::Variant::Map& args(event.getArguments());
-        qpid::types::Variant::Map::const_iterator iter = args.begin();
-        if (iter != args.end()) {
-           qpid::types::Variant::List sublist = (iter->second).asList();
-           // for each header id, get the message header
-           for (qpid::types::Variant::List::const_iterator subIter = sublist.begin();
-                 subIter != sublist.end(); subIter++) {
-                messageId = *subIter;
-
-                callMap["id"] = messageId;
-                // submit an asyncronous call to get the header
-                // and request that the gotMessageHeaders signal be emitted when ready
-                addCallback(agent, "queueGetMessageHeader", callMap, brokerData.getAddr(),
-                            SIGNAL(gotMessageHeaders()));
-                // update each header record in the tree to the current correlator
-                emit requestedMessageHeaders(messageId, correlator);
+    {
+        QMutexLocker locker(&lock);
+        // the selection moved on while the list was on its way
+        if (queue != headerQueue)
+            return;
+
+        QSet<uint32_t> current;
+        current.reserve(sublist.size());
+        for (qpid::types::Variant::List::const_iterator subIter = sublist.begin();
+             subIter != sublist.end(); subIter++) {
+            uint32_t messageId = subIter->asUint32();
+            current.insert(messageId);
+            // only new messages need their header fetched
+            if (!knownIds.contains(messageId)) {
+                added = true;
+                knownIds.insert(messageId);
+                if (windowedHeaders)
+                    addedIds.append(messageId);
+                else
+                    header_queue.push_back(HeaderRequest(queue, messageId));
             }
-            // flush out any records in the tree that will not get updated
-            emit doneRequestingHeaders(correlator);
         }
+
+        // everything we knew about that is no longer listed was consumed
+        for (QSet<uint32_t>::iterator known = knownIds.begin(); known != knownIds.end(); ) {
+            if (!current.contains(*known)) {
+                removed.append(*known);
+                known = knownIds.erase(known);
+            } else
+                ++known;
+        }
+
+        // don't bother fetching or preparing headers of messages that
+        // are already gone
+        if (!removed.isEmpty()) {
+            header_queue_t pending;
+            for (header_queue_t::const_iterator request = header_queue.begin();
+                 request != header_queue.end(); request++)
+                if (current.contains(request->id))
+                    pending.push_back(*request);
+            header_queue.swap(pending);
+
+            HeaderPreparer::ResponseList responses;
+            for (HeaderPreparer::ResponseList::const_iterator response = headerResponses.begin();
+                 response != headerResponses.end(); response++)
+                if (current.contains(response->second.find("id")->second.asUint32()))
+                    responses.push_back(*response);
+            headerResponses.swap(responses);
+        }
+
+        // poll a queue that isn't changing less often
+        scheduler.result(RefreshScheduler::HEADERS, added || !removed.isEmpty());
+
+        // signalled under lock, see headersPrepared()
+        if (!removed.isEmpty())
+            emit removedMessageHeaders(QString(queue.c_str()), removed);
     }
+    if (!addedIds.isEmpty())
+        emit addedMessageIds(QString(queue.c_str()), addedIds);
+
+    // start the first batch of header calls, the rest are issued
+    // from run() as the responses arrive
+    fillHeaderWindow();
+}
+
+// Windowed mode: ask for the headers of the messages the GUI is about to
+// show. This replaces the ids asked for last time that aren't requested yet.
+void QmfThread::fetchHeaders(const QString& name, const QList<quint32>& ids)
+{
+    qpid::types::Variant::Map map;
+    qpid::types::Variant::List list;
+    for (QList<quint32>::const_iterator iter = ids.begin(); iter != ids.end(); iter++)
+        list.push_back(qpid::types::Variant((uint32_t)*iter));
+    map["name"] = name.toStdString();
+    map["ids"] = list;
+
+    QMutexLocker locker(&lock);
+    command_queue.push_back(Command(CMD_GET_HEADERS, map));
+    cond.wakeOne();
+}
+
+// A queue was selected. The QMF thread refreshes the message ids and the
+// statistics of this queue more often than the rest.
+void QmfThread::watchQueue(const QString& name, const qmf::DataAddr& dataAddr)
+{
+    qpid::types::Variant::Map map;
+    map["name"] = name.toStdString();
+
+    Command command(CMD_WATCH, map);
+    command.dataAddr = dataAddr;
+
+    QMutexLocker locker(&lock);
+    command_queue.push_back(command);
+    cond.wakeOne();
 }
 
 void QmfThread::queueRemoveMessage(const QString& name, const qpid::types::Variant::Map& args)
 {
     Q_UNUSED(name);
-    qmf::Agent agent = brokerData.getAgent();
 
-    // submit an asyncronous call to remove the message
-    // and request that the removedMessage signal be emitted when ready
-    addCallback(agent, "queueRemoveMessage", args, brokerData.getAddr(),
-                SIGNAL(removedMessage()));
+    QMutexLocker locker(&lock);
+    command_queue.push_back(Command(CMD_REMOVE_MESSAGE, args));
+    cond.wakeOne();
+}
+
+// Purge messages from a queue and then refresh its list of messages
+void QmfThread::queuePurge(const QString& name, const qmf::DataAddr& dataAddr, uint count)
+{
+    qpid::types::Variant::Map map;
+    map["name"] = name.toStdString();
+    map["request"] = count;
+
+    Command command(CMD_PURGE, map);
+    command.dataAddr = dataAddr;
+
+    QMutexLocker locker(&lock);
+    command_queue.push_back(command);
+    cond.wakeOne();
 }
 
 // SLOT: Show the current message body
 void QmfThread::showBody(const QModelIndex& index, const qmf::ConsoleEvent &event, const qpid::types::Variant::Map &args)
 {
-    qmf::Agent agent = brokerData.getAgent();
-
     // get the expected body content type
     const qpid::types::Variant::Map& headerMap(event.getArguments());
     qpid::types::Variant::Map::const_iterator iter = headerMap.begin();
@@ -319,18 +1101,113 @@ void QmfThread::showBody(const QModelIndex& index, const qmf::ConsoleEvent &even
     qpid::types::Variant::Map map(args);
     // remember the content type so we can decode the response properly
     map["ContentType"] = contentType;
-    // make the call
-    addCallback(agent, "queueGetMessageBody", map, brokerData.getAddr(),
-                SIGNAL(gotMessageBody()), index);
+
+    // the call is made from run()
+    QMutexLocker locker(&lock);
+    command_queue.push_back(Command(CMD_GET_BODY, map, index));
+    cond.wakeOne();
+}
+
+// Register an export job and queue up its calls. The queue's properties
+// come back by gotExportQueue. Each body is reported with its position
+// in args by gotExportBody, in whatever order they arrive.
+void QmfThread::startExport(uint job, const qmf::DataAddr& addr,
+                            const std::vector<qpid::types::Variant::Map>& args)
+{
+    qpid::types::Variant::Map map;
+    map["job"] = job;
+
+    Command command(CMD_GET_QUEUE, map);
+    command.dataAddr = addr;
+
+    QMutexLocker locker(&lock);
+    exportJobs.insert(job);
+    command_queue.push_back(command);
+    for (size_t idx = 0; idx < args.size(); idx++)
+        body_queue.push_back(BodyRequest(job, idx, args[idx]));
+    cond.wakeOne();
+}
+
+// Forget the job and its bodies that haven't been asked for. The answers
+// to the calls already made are dropped. Once this returns the job is
+// never signalled again, so it can be deleted.
+void QmfThread::cancelExport(uint job)
+{
+    QMutexLocker locker(&lock);
+    exportJobs.remove(job);
+    body_queue_t pending;
+    for (body_queue_t::const_iterator request = body_queue.begin(); request != body_queue.end(); request++)
+        if (request->job != job)
+            pending.push_back(*request);
+    body_queue.swap(pending);
+}
+
+// Issue queueGetMessageBody calls for export jobs until EXPORT_WINDOW are
+// outstanding or there is nothing left to request
+void QmfThread::fillExportWindow()
+{
+    if (!brokerData.isValid())
+        return;
+    while (true) {
+        ExportCallback* callback;
+        {
+            QMutexLocker locker(&lock);
+            if (body_queue.empty() || bodiesInFlight >= EXPORT_WINDOW)
+                return;
+            const BodyRequest& request(body_queue.front());
+            callback = new ExportCallback(request.args, request.job, request.sequence);
+            body_queue.pop_front();
+            ++bodiesInFlight;
+        }
+        addCallback(brokerData.getAgent(), "queueGetMessageBody", brokerData.getAddr(), callback);
+    }
+}
+
+// Set the maximum number of outstanding queueGetMessageHeader calls
+void QmfThread::setHeaderWindow(uint window)
+{
+    QMutexLocker locker(&lock);
+    headerWindow = window > 0 ? window : 1;
+}
+
+// Set the shortest time allowed between two refreshes of the same kind
+void QmfThread::setMinimumRefresh(uint msecs)
+{
+    QMutexLocker locker(&lock);
+    scheduler.setMinimumInterval(msecs);
 }
 
-qmf::ConsoleEvent QmfThread::fetchBody(const qpid::types::Variant::Map& args)
+// New filters apply from the next queue list, which is asked for now.
+// Queues that are filtered out then drop out of the table as stale.
+void QmfThread::setQueueFilters(const QStringList& include, const QStringList& exclude)
 {
-    qmf::Agent agent = brokerData.getAgent();
-    return agent.callMethod("queueGetMessageBody", args, brokerData.getAddr());
+    QMutexLocker locker(&lock);
+    includeQueues = PrefixMatcher(include);
+    excludeQueues = PrefixMatcher(exclude);
+    scheduler.trigger(RefreshScheduler::QUEUE_LIST, clock.elapsed());
+}
+
+// The caller holds lock. Pushed updates may not carry the queue name, the
+// queue table ignores those for queues it doesn't list anyway.
+bool QmfThread::wantQueue(const QueueSample& sample) const
+{
+    if (!sample.has(QP_NAME))
+        return true;
+    if (!includeQueues.isEmpty() && !includeQueues.matches(sample.name))
+        return false;
+    return !excludeQueues.matches(sample.name);
+}
+
+// Only list the message ids and let the GUI ask for the headers it shows.
+// Takes effect when the next queue is watched.
+void QmfThread::setWindowedHeaders(bool on)
+{
+    QMutexLocker locker(&lock);
+    windowedHeaders = on;
 }
 
 void QmfThread::pauseRefreshes(bool checked)
 {
+    QMutexLocker locker(&lock);
     pausedRefreshes = checked;
 }
@@ -24,46 +24,78 @@
 #include <QWaitCondition>
 #include <QLineEdit>
 #include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QThreadPool>
 
 #include <qpid/messaging/Connection.h>
 #include <qmf/ConsoleSession.h>
 #include <qmf/ConsoleEvent.h>
 #include "qpid/types/Variant.h"
 #include <qmf/Data.h>
+#include <qmf/DataAddr.h>
+#include <qmf/Subscription.h>
+#include <qmf/Query.h>
 #include "model-header.h"
+#include "refresh-scheduler.h"
+#include "header-preparer.h"
+#include "queue-stats.h"
+#include "prefix-matcher.h"
 #include <sstream>
 #include <deque>
+#include <boost/shared_ptr.hpp>
 
-static QModelIndex defaultIndex;
 class QmfThread : public QThread {
     Q_OBJECT
 
 public:
     QmfThread(QObject* parent);
     void cancel();
-    void getQueueHeaders(const QString&);
+    void getQueueHeaders(const QString&, bool reset = false);
+    void watchQueue(const QString&, const qmf::DataAddr&);
+    void fetchHeaders(const QString&, const QList<quint32>&);
     void queueRemoveMessage(const QString&, const qpid::types::Variant::Map&);
-    qmf::ConsoleEvent fetchBody(const qpid::types::Variant::Map&);
+    void queuePurge(const QString&, const qmf::DataAddr&, uint);
+    void startExport(uint job, const qmf::DataAddr& queue, const std::vector<qpid::types::Variant::Map>&);
+    void cancelExport(uint job);
+    quint32 expiredCallCount() const;
+    int foreignThreadCallCount() const;
+    void headersPrepared(const PreparedHeaderBatch&);
 
 public slots:
     void connect_localhost();
     void disconnect();
     void connect_url(const QString&, const QString&, const QString&);
     void pauseRefreshes(bool);
+    void setHeaderWindow(uint);
+    void setMinimumRefresh(uint);
+    void setWindowedHeaders(bool);
+    void setQueueFilters(const QStringList& include, const QStringList& exclude);
     void showBody(const QModelIndex&, const qmf::ConsoleEvent &, const qpid::types::Variant::Map &);
 
 
 signals:
     void connectionStatusChanged(const QString&);
     void isConnected(bool);
-    void addQueue(const qmf::Data&, uint);
+    void addQueues(const QueueSampleBatch&, uint);
+    void updateQueues(const QueueSampleBatch&);
     void doneAddingQueues(uint);
     void headerAdded(uint);
-    void gotMessageHeaders(const qmf::ConsoleEvent&, const qpid::types::Variant::Map&);
+    void gotMessageHeaders(const PreparedHeaderBatch&);
     void gotMessageBody(const qmf::ConsoleEvent&, const qpid::types::Variant::Map&, const QModelIndex&);
     void removedMessage(const qmf::ConsoleEvent&, const qpid::types::Variant::Map&);
-    void requestedMessageHeaders(quint32, quint32);
-    void doneRequestingHeaders(quint32);
+    void removedMessageHeaders(const QString&, const QList<quint32>&);
+    void addedMessageIds(const QString&, const QList<quint32>&);
+    // all the properties of an export job's queue
+    void gotExportQueue(uint job, const qmf::Data&);
+    // the body of an export job's message
+    void gotExportBody(uint job, int sequence, const qmf::ConsoleEvent&);
+    // one of an export job's calls failed, sequence is -1 if it wasn't
+    // for a message
+    void exportFailed(uint job, int sequence, const QString& error);
 
     void qmfError(const QString&);
 
@@ -71,14 +103,24 @@ protected:
     void run();
 
 private:
+    typedef enum { CMD_CONNECT, CMD_DISCONNECT, CMD_GET_HEADER_IDS, CMD_WATCH,
+                   CMD_GET_HEADERS, CMD_REMOVE_MESSAGE, CMD_GET_BODY, CMD_PURGE,
+                   CMD_GET_QUEUE } CommandType;
+
+    // Requests posted from the GUI thread. All QMF traffic is done by run().
     struct Command {
-        bool connect;
+        CommandType type;
         std::string url;
         std::string conn_options;
         std::string qmf_options;
+        qpid::types::Variant::Map args;
+        QModelIndex index;
+        qmf::DataAddr dataAddr;
 
-        Command(bool _c, const std::string& _u, const std::string& _co, const std::string& _qo) :
-            connect(_c), url(_u), conn_options(_co), qmf_options(_qo) {}
+        Command(CommandType _t, const std::string& _u = "", const std::string& _co = "", const std::string& _qo = "") :
+            type(_t), url(_u), conn_options(_co), qmf_options(_qo) {}
+        Command(CommandType _t, const qpid::types::Variant::Map& _a, const QModelIndex& _i = QModelIndex()) :
+            type(_t), args(_a), index(_i) {}
     };
     typedef std::deque<Command> command_queue_t;
 
@@ -91,27 +133,191 @@ private:
     bool pausedRefreshes;
     command_queue_t command_queue;
 
+    // A pending asynchronous method call or query. Each kind of call has its own
+    // subclass that knows which signal to emit with the response.
     struct Callback {
-        uint32_t correlator;
-        std::string method;
         qpid::types::Variant::Map args;
+        qint64 deadline;    // msecs on the thread clock
+
+        Callback(const qpid::types::Variant::Map& _a) : args(_a), deadline(0) {}
+        virtual ~Callback() {}
+        virtual void respond(QmfThread&, const qmf::ConsoleEvent&) = 0;
+        // called instead of respond() when the call failed or timed out
+        virtual void failed(QmfThread&, const QString& error) { Q_UNUSED(error); }
+        // true if the call occupies a slot in the header window
+        virtual bool isHeaderCall() const { return false; }
+        // true if the call occupies a slot in the export window
+        virtual bool isExportCall() const { return false; }
+    };
+
+    struct HeaderCallback : public Callback {
+        HeaderCallback(const qpid::types::Variant::Map& _a) : Callback(_a) {}
+        void respond(QmfThread&, const qmf::ConsoleEvent&);
+        void failed(QmfThread&, const QString& error);
+        bool isHeaderCall() const { return true; }
+    };
+
+    struct BodyCallback : public Callback {
         QModelIndex index;
 
-        Callback(std::string _m, const qpid::types::Variant::Map& _a, const QModelIndex& _i) : correlator(0),
-            method(_m), args(_a), index(_i) {}
+        BodyCallback(const qpid::types::Variant::Map& _a, const QModelIndex& _i) : Callback(_a), index(_i) {}
+        void respond(QmfThread&, const qmf::ConsoleEvent&);
+    };
+
+    struct ExportCallback : public Callback {
+        uint job;
+        int sequence;
+
+        ExportCallback(const qpid::types::Variant::Map& _a, uint _j, int _s) : Callback(_a), job(_j), sequence(_s) {}
+        void respond(QmfThread&, const qmf::ConsoleEvent&);
+        void failed(QmfThread&, const QString& error);
+        bool isExportCall() const { return true; }
+    };
+
+    // a query for all of one queue's properties
+    struct QueueCallback : public Callback {
+        uint job;
+
+        QueueCallback(uint _j) : Callback(qpid::types::Variant::Map()), job(_j) {}
+        void respond(QmfThread&, const qmf::ConsoleEvent&);
+        void failed(QmfThread&, const QString& error);
+    };
+
+    struct RemoveCallback : public Callback {
+        RemoveCallback(const qpid::types::Variant::Map& _a) : Callback(_a) {}
+        void respond(QmfThread&, const qmf::ConsoleEvent&);
+    };
+
+    struct IdListCallback : public Callback {
+        IdListCallback(const qpid::types::Variant::Map& _a) : Callback(_a) {}
+        void respond(QmfThread&, const qmf::ConsoleEvent&);
+        void failed(QmfThread&, const QString& error);
+    };
+
+    struct PurgeCallback : public Callback {
+        std::string queue;
+
+        PurgeCallback(const qpid::types::Variant::Map& _a, const std::string& _q) : Callback(_a), queue(_q) {}
+        void respond(QmfThread&, const qmf::ConsoleEvent&);
+    };
+
+    typedef boost::shared_ptr<Callback> CallbackPtr;
+    typedef QHash<uint32_t, CallbackPtr> callback_map_t;
+    // correlators in the order the calls were made. Every call gets the same
+    // timeout, so this is also the order in which they expire.
+    typedef std::deque<std::pair<qint64, uint32_t> > deadline_queue_t;
+
+    callback_map_t callbacks;
+    deadline_queue_t deadlines;
+    QElapsedTimer clock;
+    quint32 expiredCalls;
+
+    // Message ids whose headers are still to be requested. At most
+    // headerWindow queueGetMessageHeader calls are outstanding at once;
+    // the window is refilled as the responses come back.
+    struct HeaderRequest {
+        std::string queue;
+        uint32_t id;
+
+        HeaderRequest(const std::string& _q, uint32_t _i) : queue(_q), id(_i) {}
     };
+    typedef std::deque<HeaderRequest> header_queue_t;
+
+    header_queue_t header_queue;
+    uint headerWindow;
+    uint headersInFlight;
+
+    // The queue whose message ids were last listed and the ids whose
+    // headers have been requested. Only ids that are not in knownIds are
+    // fetched on a refresh.
+    std::string headerQueue;
+    QSet<uint32_t> knownIds;
+
+    // In windowed mode new ids are only reported, and headers are fetched
+    // for the ids the GUI asks for. requestedIds are the calls in flight.
+    bool windowedHeaders;
+    QSet<uint32_t> requestedIds;
+
+    // Message bodies wanted by export jobs, in the order they are to be
+    // written. At most EXPORT_WINDOW calls are outstanding at once.
+    struct BodyRequest {
+        uint job;
+        int sequence;
+        qpid::types::Variant::Map args;
+
+        BodyRequest(uint _j, int _s, const qpid::types::Variant::Map& _a) : job(_j), sequence(_s), args(_a) {}
+    };
+    typedef std::deque<BodyRequest> body_queue_t;
+
+    body_queue_t body_queue;
+    uint bodiesInFlight;
+    // the jobs that may be signalled, see cancelExport()
+    QSet<uint> exportJobs;
+    void signalExportQueue(uint job, const qmf::Data&);
+    void signalExportFailed(uint job, int sequence, const QString& error);
+
+    // Header responses waiting to be converted for display, and the
+    // pool that converts them. It has one thread, so the batches reach
+    // the GUI in the order they were made.
+    HeaderPreparer::ResponseList headerResponses;
+    qint64 headerBatchStarted;
+    QThreadPool preparers;
+
+    // number of QMF calls made from some other thread than this one
+    QAtomicInt foreignCalls;
+
+    // when to refresh the queue list, the selected queue's message ids
+    // and the selected queue's statistics
+    RefreshScheduler scheduler;
+    qmf::DataAddr watchedAddr;
+    uint32_t queueListCorrelator;
+    uint32_t statsCorrelator;
+    bool queueListPending;
+    qint64 queueListStarted;
+    bool idListPending;
+    quint64 queueListActivity;  // sum of the counters seen by the current query
+    quint64 lastQueueListActivity;
+    quint64 watchedActivity;
+
+    // Queue statistics pushed by the broker. Polling is only needed when
+    // the agent can't push them.
+    qmf::Subscription statsSubscription;
+    bool statsPushed;
+    // pushed updates not yet passed to the GUI
+    std::vector<QueueSample> statsUpdates;
+    qint64 statsBatchStarted;
 
-    typedef std::deque<Callback> callback_queue_t;
+    // The user's queue filters. A queue is passed on to the GUI when its
+    // name starts with an include prefix, or there are none, and with no
+    // exclude prefix. Guarded by lock.
+    PrefixMatcher includeQueues;
+    PrefixMatcher excludeQueues;
+    bool wantQueue(const QueueSample&) const;
 
-    callback_queue_t callback_queue;
+    void runTimers();
+    void gotQueues(const qmf::ConsoleEvent&);
+    void subscribeQueueStats();
+    void setStatsPushed(bool);
+    void gotQueueStats(const qmf::ConsoleEvent&);
+    void flushQueueStats(bool force);
+    void gotAgentEvent(const qmf::ConsoleEvent&);
 
+    void fillHeaderWindow();
+    void fillExportWindow();
+    void flushHeaderResponses(bool force);
+    bool isCurrentHeader(const PreparedHeader&) const;
+    void runCommand(const Command&);
+    void requestHeaderIds(const qpid::types::Variant::Map&);
+    void gotHeaderIds(const qmf::ConsoleEvent&, const qpid::types::Variant::Map&);
+    void checkThread(const char*);
     void callCallback(const qmf::ConsoleEvent&);
-    void emitCallback(const Callback& cb, const qmf::ConsoleEvent& event);
+    CallbackPtr takeCallback(uint32_t correlator);
+    void expireCallbacks();
     void addCallback(qmf::Agent, const std::string&,
-                                const qpid::types::Variant::Map&,
                                 const qmf::DataAddr&,
-                                const std::string&,
-                                const QModelIndex& = defaultIndex);
+                                Callback*);
+    void addQueryCallback(qmf::Agent, const qmf::Query&, Callback*);
+    void rememberCallback(uint32_t correlator, const CallbackPtr&);
 
     // remember the broker object so we can make qmf calls
     qmf::Data brokerData;
@@ -0,0 +1,142 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "queue-exporter.h"
+#include "model-queue.h"
+#include <qpid/messaging/Message.h>
+#include <sstream>
+
+QueueExporter::QueueExporter(QIODevice* device) : out(device), written(0)
+{
+    pending.reserve(FLUSH_SIZE);
+}
+
+// treat the queue name property as an attribute and export all the
+// other properties
+void QueueExporter::beginQueue(const qmf::Data& queue)
+{
+    std::stringstream element;
+    element << "<queue";
+    if (queue.isValid()) {
+        const qpid::types::Variant::Map& attrs(queue.getProperties());
+        qpid::types::Variant::Map::const_iterator iter = attrs.find("name");
+        if (iter != attrs.end())
+            element << " name=\"" << iter->second.asString() << "\"";
+    }
+    element << ">\n";
+    element << queue;
+    element << " <messages>\n";
+    append(element.str());
+}
+
+void QueueExporter::writeMessage(const std::string& messageId, const qmf::ConsoleEvent& header, const QString& body)
+{
+    std::stringstream element;
+    element << "  <message sequence=\"" << messageId << "\">\n";
+
+    // add all the message header attributes returned by the call
+    element << "   <arguments>\n";
+    const qpid::types::Variant::Map& args(header.getArguments());
+    for (qpid::types::Variant::Map::const_iterator iter = args.begin(); iter != args.end(); iter++) {
+        qpid::types::Variant::Map attrs = (iter->second).asMap();
+        for (qpid::types::Variant::Map::const_iterator attr = attrs.begin(); attr != attrs.end(); attr++) {
+            element << "    <argument>\n";
+            element << "      <name>" << attr->first << "</name>\n";
+            element << "      <value>" << attr->second << "</value>\n";
+            element << "    </argument>\n";
+        }
+    }
+    element << "   </arguments>\n";
+
+    // XML with no declaration is UTF-8
+    QByteArray utf8(body.toUtf8());
+    element << "   <body>";
+    element.write(utf8.constData(), utf8.size());
+    element << "</body>\n";
+
+    element << "  </message>\n";
+    append(element.str());
+}
+
+void QueueExporter::endQueue()
+{
+    append(" </messages>\n</queue>\n");
+    flush();
+}
+
+std::string QueueExporter::contentType(const qmf::ConsoleEvent& header)
+{
+    const qpid::types::Variant::Map& args(header.getArguments());
+    qpid::types::Variant::Map::const_iterator iter = args.begin();
+    if (iter == args.end())
+        return std::string();
+    const qpid::types::Variant::Map& attrs(iter->second.asMap());
+    iter = attrs.find("ContentType");
+    if (iter == attrs.end())
+        return std::string();
+    return iter->second.asString();
+}
+
+QString QueueExporter::decodeBody(const qpid::types::Variant& var, const std::string& contentType)
+{
+    QString body;
+    if (contentType == "amqp/map") {
+
+        qpid::messaging::Message message;
+        message.setContent(var.asString());
+        message.setContentType(contentType);
+
+        qpid::types::Variant::Map bodyMap;
+        qpid::messaging::decode(message, bodyMap);
+
+        std::stringstream bodyStream;
+        bodyStream << bodyMap;
+        body = QString(bodyStream.str().c_str());
+    } else if (contentType == "amqp/list") {
+        body = QString("TODO: decode the list");
+    } else {
+        body = QString(var.asString().c_str());
+    }
+    return body;
+}
+
+// Once a write fails the rest of the export is dropped
+void QueueExporter::append(const char* data, size_t length)
+{
+    if (!isOk())
+        return;
+    pending.append(data, length);
+    if (pending.size() >= (size_t)FLUSH_SIZE)
+        flush();
+}
+
+void QueueExporter::flush()
+{
+    if (!isOk() || pending.empty())
+        return;
+    if (out->write(pending.data(), pending.size()) != (qint64)pending.size()) {
+        errorText = out->errorString();
+        if (errorText.isEmpty())
+            errorText = QObject::tr("Unable to write the export");
+        return;
+    }
+    written += pending.size();
+    pending.clear();
+}
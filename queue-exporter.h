@@ -0,0 +1,81 @@
+#ifndef _qe_queue_exporter_h
+#define _qe_queue_exporter_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include <QIODevice>
+#include <QString>
+#include <qmf/Data.h>
+#include <qmf/ConsoleEvent.h>
+#include <qpid/types/Variant.h>
+#include <string>
+
+//
+// Writes a queue export to a device as it is produced. The queue's
+// properties go out first, then each message as its body arrives, so
+// only the current element and a small write buffer are held however
+// many messages the queue has:
+//
+//   <queue name="...">
+//    <properties> ... </properties>
+//    <messages>
+//     <message sequence="..."> ... </message>
+//    </messages>
+//   </queue>
+//
+// Subclasses write other formats through the same buffering.
+//
+class QueueExporter {
+public:
+    QueueExporter(QIODevice* out);
+    virtual ~QueueExporter() {}
+
+    virtual void beginQueue(const qmf::Data& queue);
+    // header is the message's queueGetMessageHeader response
+    virtual void writeMessage(const std::string& messageId, const qmf::ConsoleEvent& header, const QString& body);
+    // writes the closing tags and anything still buffered
+    virtual void endQueue();
+
+    bool isOk() const { return errorText.isEmpty(); }
+    const QString& errorString() const { return errorText; }
+    qint64 bytesWritten() const { return written + (qint64)pending.size(); }
+
+    // the content type in a message's header, and the text of a body
+    // with that content type
+    static std::string contentType(const qmf::ConsoleEvent& header);
+    static QString decodeBody(const qpid::types::Variant& body, const std::string& contentType);
+
+protected:
+    void append(const char* data, size_t length);
+    void append(const std::string& text) { append(text.data(), text.size()); }
+    void flush();
+
+private:
+    // output is written once this much has built up
+    enum { FLUSH_SIZE = 64 * 1024 };
+
+    QIODevice*  out;
+    std::string pending;
+    qint64      written;
+    QString     errorText;
+};
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "queue-history.h"
+
+void QueueHistory::record(qint64 time, const quint64* values, qint64 minGap)
+{
+    Sample* sample;
+    if (used > 0 && (time <= this->time(used - 1) ||
+                     (used > 1 && time - this->time(used - 2) < minGap))) {
+        sample = &samples[slot(used - 1)];
+    } else {
+        sample = &samples[head];
+        head = (head + 1) % SIZE;
+        if (used < SIZE)
+            ++used;
+    }
+
+    sample->time = time;
+    for (int which = 0; which < VALUES; which++)
+        sample->values[which] = values[which];
+}
+
+bool QueueHistory::rate(int which, int span, quint64& perSecond) const
+{
+    if (used < 2)
+        return false;
+    int first = used - 1 - span;
+    if (first < 0)
+        first = 0;
+    perSecond = rateBetween(samples[slot(first)], samples[slot(used - 1)], which);
+    return true;
+}
+
+quint64 QueueHistory::rateAt(int idx, int which) const
+{
+    return rateBetween(samples[slot(idx - 1)], samples[slot(idx)], which);
+}
+
+// A counter that went down was reset, so it has no rate
+quint64 QueueHistory::rateBetween(const Sample& from, const Sample& to, int which)
+{
+    qint64 msecs = to.time - from.time;
+    if (msecs <= 0 || to.values[which] < from.values[which])
+        return 0;
+    return (to.values[which] - from.values[which]) * RATE_SCALE * 1000 / msecs;
+}
@@ -0,0 +1,70 @@
+#ifndef _qe_queue_history_h
+#define _qe_queue_history_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <QtGlobal>
+
+// rates are kept in thousandths per second so slow queues don't show 0
+const quint64 RATE_SCALE = 1000;
+
+//
+// The last SIZE samples of a few counters of one queue. The samples are
+// kept in a ring buffer that overwrites the oldest one, so the memory
+// used per queue is fixed, and recording a sample or working out a rate
+// is O(1).
+//
+class QueueHistory {
+public:
+    enum { SIZE = 16, VALUES = 6 };
+
+    QueueHistory() : head(0), used(0) {}
+
+    // Record VALUES counters. A sample less than minGap msecs after the
+    // one before the newest replaces the newest, so bursts of updates
+    // don't push the older samples out.
+    void record(qint64 time, const quint64* values, qint64 minGap);
+
+    int count() const { return used; }
+    // idx 0 is the oldest sample
+    qint64 time(int idx) const { return samples[slot(idx)].time; }
+    quint64 value(int idx, int which) const { return samples[slot(idx)].values[which]; }
+
+    // How fast a counter went up over the last span intervals, in
+    // RATE_SCALE units per second. False until there are two samples.
+    bool rate(int which, int span, quint64& perSecond) const;
+    // the rate between samples idx - 1 and idx
+    quint64 rateAt(int idx, int which) const;
+
+private:
+    struct Sample {
+        qint64  time;
+        quint64 values[VALUES];
+    };
+
+    Sample  samples[SIZE];
+    quint8  head;       // where the next sample goes
+    quint8  used;
+
+    int slot(int idx) const { return (head + SIZE - used + idx) % SIZE; }
+    static quint64 rateBetween(const Sample&, const Sample&, int which);
+};
+
+#endif
@@ -0,0 +1,531 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "queue-proxy.h"
+#include "model-queue.h"
+#include "row-runs.h"
+#include <algorithm>
+
+namespace {
+    // orders source rows for the standard algorithms
+    struct RowLess {
+        const QueueProxyModel* proxy;
+        RowLess(const QueueProxyModel* p) : proxy(p) {}
+        bool operator()(int left, int right) const { return proxy->lessThan(left, right); }
+    };
+}
+
+QueueProxyModel::QueueProxyModel(QueueTableModel* source, QObject* parent) :
+    QAbstractProxyModel(parent), queues(source), sortCol(0), order(Qt::AscendingOrder)
+{
+    setSourceModel(source);
+
+    connect(source, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(sourceRowsInserted(QModelIndex,int,int)));
+    connect(source, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)), this, SLOT(sourceRowsAboutToBeRemoved(QModelIndex,int,int)));
+    connect(source, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(sourceRowsRemoved(QModelIndex,int,int)));
+    connect(source, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(sourceDataChanged(QModelIndex,QModelIndex)));
+    connect(source, SIGNAL(modelAboutToBeReset()), this, SLOT(sourceAboutToBeReset()));
+    connect(source, SIGNAL(modelReset()), this, SLOT(sourceReset()));
+    connect(source, SIGNAL(columnsAboutToBeInserted(QModelIndex,int,int)), this, SLOT(sourceColumnsAboutToBeInserted(QModelIndex,int,int)));
+    connect(source, SIGNAL(columnsInserted(QModelIndex,int,int)), this, SLOT(sourceColumnsInserted(QModelIndex,int,int)));
+    connect(source, SIGNAL(columnsAboutToBeRemoved(QModelIndex,int,int)), this, SLOT(sourceColumnsAboutToBeRemoved(QModelIndex,int,int)));
+    connect(source, SIGNAL(columnsRemoved(QModelIndex,int,int)), this, SLOT(sourceColumnsRemoved(QModelIndex,int,int)));
+    connect(source, SIGNAL(rowShownChanged(int)), this, SLOT(sourceRowShownChanged(int)));
+    connect(source, SIGNAL(rowsAboutToBeErased(QVector<bool>)), this, SLOT(sourceRowsAboutToBeErased(QVector<bool>)));
+    connect(source, SIGNAL(rowsErased(QVector<bool>)), this, SLOT(sourceRowsErased(QVector<bool>)));
+    connect(source, SIGNAL(shownRowsChanged()), this, SLOT(refilter()));
+
+    reindex();
+    rebuild();
+}
+
+QModelIndex QueueProxyModel::index(int row, int column, const QModelIndex& parent) const
+{
+    if (parent.isValid() || row < 0 || row >= proxyRows.size() || column < 0 || column >= columnCount())
+        return QModelIndex();
+    return createIndex(row, column);
+}
+
+QModelIndex QueueProxyModel::parent(const QModelIndex& child) const
+{
+    Q_UNUSED(child);
+    return QModelIndex();
+}
+
+int QueueProxyModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return proxyRows.size();
+}
+
+int QueueProxyModel::columnCount(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return queues->columnCount();
+}
+
+// The column headers come straight from the source so they are there
+// even when every row is filtered out
+QVariant QueueProxyModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal)
+        return queues->headerData(section, orientation, role);
+    return QAbstractItemModel::headerData(section, orientation, role);
+}
+
+QModelIndex QueueProxyModel::mapToSource(const QModelIndex& proxyIndex) const
+{
+    if (!proxyIndex.isValid() || proxyIndex.row() >= proxyRows.size())
+        return QModelIndex();
+    return queues->index(proxyRows[proxyIndex.row()], proxyIndex.column());
+}
+
+QModelIndex QueueProxyModel::mapFromSource(const QModelIndex& sourceIndex) const
+{
+    if (!sourceIndex.isValid() || sourceIndex.row() >= sourceRows.size())
+        return QModelIndex();
+    int row = sourceRows[sourceIndex.row()];
+    if (row < 0)
+        return QModelIndex();
+    return index(row, sourceIndex.column());
+}
+
+// Ties are broken on the source row so the order is total and a row's
+// position can be found with a binary search
+bool QueueProxyModel::lessThan(int left, int right) const
+{
+    if (sortCol >= 0) {
+        int cmp = queues->compare(left, right, sortCol);
+        if (cmp != 0)
+            return order == Qt::AscendingOrder ? cmp < 0 : cmp > 0;
+    }
+    return left < right;
+}
+
+bool QueueProxyModel::accepts(int sourceRow) const
+{
+    if (!queues->isShown(sourceRow))
+        return false;
+    return filter.isEmpty() || queues->queueName(sourceRow).contains(filter, Qt::CaseInsensitive);
+}
+
+// The source rows that pass the filter text, in source order. The index
+// narrows them down to the rows that have all of the filter's trigrams.
+void QueueProxyModel::matchingRows(QVector<int>& rows) const
+{
+    names.candidates(filter, rows);
+    if (filter.isEmpty())
+        return;
+
+    int kept = 0;
+    for (int idx=0; idx<rows.size(); idx++)
+        if (queues->queueName(rows[idx]).contains(filter, Qt::CaseInsensitive))
+            rows[kept++] = rows[idx];
+    rows.resize(kept);
+}
+
+void QueueProxyModel::reindex()
+{
+    int count = queues->rowCount();
+    QVector<QString> all(count);
+    for (int row=0; row<count; row++)
+        all[row] = queues->queueName(row);
+    names.clear();
+    names.insertRows(0, all);
+}
+
+// Bring the source -> proxy map in line with proxyRows
+void QueueProxyModel::remap()
+{
+    sourceRows.fill(-1);
+    for (int row=0; row<proxyRows.size(); row++)
+        sourceRows[proxyRows[row]] = row;
+}
+
+// Filter and sort all the source rows from scratch
+void QueueProxyModel::rebuild()
+{
+    int count = queues->rowCount();
+    QVector<int> matched;
+    matchingRows(matched);
+
+    proxyRows.clear();
+    proxyRows.reserve(matched.size());
+    for (int idx=0; idx<matched.size(); idx++)
+        if (queues->isShown(matched[idx]))
+            proxyRows.append(matched[idx]);
+    std::sort(proxyRows.begin(), proxyRows.end(), RowLess(this));
+
+    sourceRows.resize(count);
+    remap();
+}
+
+// Rebuild the order, moving the views' persistent indexes along with
+// their rows
+void QueueProxyModel::relayout()
+{
+    emit layoutAboutToBeChanged();
+
+    QModelIndexList from = persistentIndexList();
+    QVector<int> sources(from.size());
+    for (int idx=0; idx<from.size(); idx++)
+        sources[idx] = proxyRows[from[idx].row()];
+
+    rebuild();
+
+    QModelIndexList to;
+    for (int idx=0; idx<from.size(); idx++) {
+        int row = sourceRows[sources[idx]];
+        to.append(row < 0 ? QModelIndex() : index(row, from[idx].column()));
+    }
+    changePersistentIndexList(from, to);
+
+    emit layoutChanged();
+}
+
+void QueueProxyModel::sort(int column, Qt::SortOrder newOrder)
+{
+    if (column == sortCol && newOrder == order)
+        return;
+    sortCol = column;
+    order = newOrder;
+    relayout();
+}
+
+void QueueProxyModel::setFilterFixedString(const QString& text)
+{
+    if (text == filter)
+        return;
+    filter = text;
+    refilter();
+}
+
+// Only the rows whose match changed are inserted or removed. The names
+// are only compared for the index's candidates, so a keystroke costs
+// about as much as the rows it could match.
+void QueueProxyModel::refilter()
+{
+    QVector<int> matched;
+    matchingRows(matched);
+    QVector<bool> isMatch(sourceRows.size());
+    for (int idx=0; idx<matched.size(); idx++)
+        isMatch[matched[idx]] = true;
+
+    QVector<bool> rejected(proxyRows.size());
+    for (int row=0; row<proxyRows.size(); row++)
+        rejected[row] = !isMatch[proxyRows[row]] || !queues->isShown(proxyRows[row]);
+    removeProxyRows(rejected);
+
+    QVector<int> accepted;
+    for (int idx=0; idx<matched.size(); idx++) {
+        int row = matched[idx];
+        if (sourceRows[row] < 0 && queues->isShown(row))
+            accepted.append(row);
+    }
+    insertSourceRows(accepted);
+}
+
+// Merge source rows that aren't shown yet into the sorted order. New rows
+// that land next to each other are inserted together, bottom up so the
+// places found for the groups above them stay right. When they land in
+// many places they are merged in with a single layout change instead.
+void QueueProxyModel::insertSourceRows(QVector<int> rows)
+{
+    if (rows.isEmpty())
+        return;
+    std::sort(rows.begin(), rows.end(), RowLess(this));
+
+    // the proxy row each new row goes in front of, in one walk down
+    QVector<int> places(rows.size());
+    int pos = 0;
+    int groups = 0;
+    for (int idx=0; idx<rows.size(); idx++) {
+        while (pos < proxyRows.size() && !lessThan(rows[idx], proxyRows[pos]))
+            ++pos;
+        places[idx] = pos;
+        if (idx == 0 || places[idx - 1] != pos)
+            ++groups;
+    }
+
+    if (groups > MAX_REMOVE_RUNS) {
+        emit layoutAboutToBeChanged();
+
+        QModelIndexList from = persistentIndexList();
+        QVector<int> sources(from.size());
+        for (int idx=0; idx<from.size(); idx++)
+            sources[idx] = proxyRows[from[idx].row()];
+
+        QVector<int> merged(proxyRows.size() + rows.size());
+        std::merge(proxyRows.begin(), proxyRows.end(), rows.begin(), rows.end(),
+                   merged.begin(), RowLess(this));
+        proxyRows = merged;
+        remap();
+
+        QModelIndexList to;
+        for (int idx=0; idx<from.size(); idx++)
+            to.append(index(sourceRows[sources[idx]], from[idx].column()));
+        changePersistentIndexList(from, to);
+
+        emit layoutChanged();
+        return;
+    }
+
+    int end = rows.size();
+    while (end > 0) {
+        int first = end - 1;
+        while (first > 0 && places[first - 1] == places[end - 1])
+            --first;
+        int at = places[first];
+        int count = end - first;
+
+        beginInsertRows(QModelIndex(), at, at + count - 1);
+        proxyRows.insert(at, count, 0);
+        for (int idx=0; idx<count; idx++)
+            proxyRows[at + idx] = rows[first + idx];
+        // only the rows from the insert point down have moved
+        for (int row=at; row<proxyRows.size(); row++)
+            sourceRows[proxyRows[row]] = row;
+        endInsertRows();
+
+        end = first;
+    }
+}
+
+// Remove the flagged proxy rows a run at a time, or with a single layout
+// change when they are scattered
+void QueueProxyModel::removeProxyRows(const QVector<bool>& flagged)
+{
+    RowRunList runs(flaggedRuns(flagged));
+    if (runs.empty())
+        return;
+
+    if ((int)runs.size() > MAX_REMOVE_RUNS) {
+        emit layoutAboutToBeChanged();
+
+        QModelIndexList from = persistentIndexList();
+        QVector<int> sources(from.size());
+        for (int idx=0; idx<from.size(); idx++)
+            sources[idx] = proxyRows[from[idx].row()];
+
+        eraseFlagged(proxyRows, flagged);
+        remap();
+
+        QModelIndexList to;
+        for (int idx=0; idx<from.size(); idx++) {
+            int row = sourceRows[sources[idx]];
+            to.append(row < 0 ? QModelIndex() : index(row, from[idx].column()));
+        }
+        changePersistentIndexList(from, to);
+
+        emit layoutChanged();
+        return;
+    }
+
+    for (RowRunList::const_iterator run = runs.begin(); run != runs.end(); run++) {
+        beginRemoveRows(QModelIndex(), run->first, run->second);
+        proxyRows.remove(run->first, run->second - run->first + 1);
+        remap();
+        endRemoveRows();
+    }
+}
+
+// Move a row whose sort key changed to its new place. Returns the row's
+// proxy row afterwards.
+int QueueProxyModel::reposition(int row)
+{
+    int source = proxyRows[row];
+    int dest;
+
+    if (row > 0 && lessThan(source, proxyRows[row - 1]))
+        dest = std::upper_bound(proxyRows.begin(), proxyRows.begin() + row,
+                                source, RowLess(this)) - proxyRows.begin();
+    else if (row < proxyRows.size() - 1 && lessThan(proxyRows[row + 1], source))
+        dest = std::upper_bound(proxyRows.begin() + row + 1, proxyRows.end(),
+                                source, RowLess(this)) - proxyRows.begin();
+    else
+        return row;
+
+    // dest is the row it goes in front of, counted before the move
+    beginMoveRows(QModelIndex(), row, row, QModelIndex(), dest);
+    proxyRows.remove(row);
+    int now = dest > row ? dest - 1 : dest;
+    proxyRows.insert(now, source);
+
+    int first = qMin(row, now);
+    int last = qMax(row, now);
+    for (int idx=first; idx<=last; idx++)
+        sourceRows[proxyRows[idx]] = idx;
+    endMoveRows();
+
+    return now;
+}
+
+void QueueProxyModel::sourceRowsInserted(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    int count = last - first + 1;
+
+    QVector<QString> added(count);
+    for (int row=first; row<=last; row++)
+        added[row - first] = queues->queueName(row);
+    names.insertRows(first, added);
+
+    // rows after the insert point have moved down in the source
+    for (int row=0; row<proxyRows.size(); row++)
+        if (proxyRows[row] >= first)
+            proxyRows[row] += count;
+    sourceRows.resize(queues->rowCount());
+    remap();
+
+    QVector<int> accepted;
+    for (int row=first; row<=last; row++)
+        if (accepts(row))
+            accepted.append(row);
+    insertSourceRows(accepted);
+}
+
+// The proxy rows are removed while the source rows still exist
+void QueueProxyModel::sourceRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    QVector<bool> flagged(proxyRows.size());
+    for (int row=first; row<=last; row++)
+        if (sourceRows[row] >= 0)
+            flagged[sourceRows[row]] = true;
+    removeProxyRows(flagged);
+}
+
+void QueueProxyModel::sourceRowsRemoved(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    int count = last - first + 1;
+    names.removeRows(first, last);
+    for (int row=0; row<proxyRows.size(); row++)
+        if (proxyRows[row] > last)
+            proxyRows[row] -= count;
+    sourceRows.resize(queues->rowCount());
+    remap();
+}
+
+// Scattered source rows are going. The proxy rows are removed with the
+// same layout change removeProxyRows() uses while the source rows exist.
+void QueueProxyModel::sourceRowsAboutToBeErased(const QVector<bool>& flagged)
+{
+    QVector<bool> gone(proxyRows.size());
+    for (int row=0; row<flagged.size(); row++)
+        if (flagged[row] && sourceRows[row] >= 0)
+            gone[sourceRows[row]] = true;
+    removeProxyRows(gone);
+}
+
+// The source has been compacted, renumber the rows that are left
+void QueueProxyModel::sourceRowsErased(const QVector<bool>& flagged)
+{
+    std::vector<int> kept(keptRows(flagged));
+    names.removeFlagged(flagged);
+    for (int row=0; row<proxyRows.size(); row++)
+        proxyRows[row] = kept[proxyRows[row]];
+    sourceRows.resize(queues->rowCount());
+    remap();
+}
+
+// A queue's name never changes, so only the order can be affected
+void QueueProxyModel::sourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    bool keyChanged = sortCol >= topLeft.column() && sortCol <= bottomRight.column();
+
+    for (int source=topLeft.row(); source<=bottomRight.row(); source++) {
+        int row = sourceRows[source];
+        if (row < 0)
+            continue;
+        if (keyChanged)
+            row = reposition(row);
+        emit dataChanged(index(row, topLeft.column()), index(row, bottomRight.column()));
+    }
+}
+
+// A row went in or out of the top N. The same row may be reported more
+// than once, so only act on a real change.
+void QueueProxyModel::sourceRowShownChanged(int source)
+{
+    if (source >= sourceRows.size())
+        return;
+    int row = sourceRows[source];
+    bool accepted = accepts(source);
+
+    if (row < 0 && accepted) {
+        insertSourceRows(QVector<int>(1, source));
+    } else if (row >= 0 && !accepted) {
+        beginRemoveRows(QModelIndex(), row, row);
+        proxyRows.remove(row);
+        remap();
+        endRemoveRows();
+    }
+}
+
+void QueueProxyModel::sourceAboutToBeReset()
+{
+    beginResetModel();
+}
+
+void QueueProxyModel::sourceReset()
+{
+    reindex();
+    rebuild();
+    endResetModel();
+}
+
+void QueueProxyModel::sourceColumnsAboutToBeInserted(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    beginInsertColumns(QModelIndex(), first, last);
+}
+
+void QueueProxyModel::sourceColumnsInserted(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    if (sortCol >= first)
+        sortCol += last - first + 1;
+    endInsertColumns();
+}
+
+void QueueProxyModel::sourceColumnsAboutToBeRemoved(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    beginRemoveColumns(QModelIndex(), first, last);
+}
+
+// When the sort column goes away, fall back to sorting by name
+void QueueProxyModel::sourceColumnsRemoved(const QModelIndex& parent, int first, int last)
+{
+    Q_UNUSED(parent);
+    bool lostKey = sortCol >= first && sortCol <= last;
+    if (sortCol > last)
+        sortCol -= last - first + 1;
+    endRemoveColumns();
+
+    if (lostKey) {
+        sortCol = 0;
+        order = Qt::AscendingOrder;
+        relayout();
+    }
+}
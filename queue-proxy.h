@@ -0,0 +1,104 @@
+#ifndef _qe_queue_proxy_h
+#define _qe_queue_proxy_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <QAbstractProxyModel>
+#include <QVector>
+#include <QString>
+#include "ngram-index.h"
+
+class QueueTableModel;
+
+//
+// Sorts and filters the queue table. Unlike QSortFilterProxyModel, the
+// order is kept up to date incrementally: a changed statistic only moves
+// its own row, new queues are merged in at their sorted position, and the
+// rows are compared on the raw counters instead of through QVariant.
+// The filter is a case-insensitive substring of the queue name, looked up
+// in a trigram index of the names, and in top N mode only the rows the
+// source says are shown get through.
+//
+class QueueProxyModel : public QAbstractProxyModel {
+    Q_OBJECT
+
+public:
+    QueueProxyModel(QueueTableModel* source, QObject* parent = 0);
+
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const;
+    QModelIndex parent(const QModelIndex& child) const;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+    QModelIndex mapToSource(const QModelIndex& proxyIndex) const;
+    QModelIndex mapFromSource(const QModelIndex& sourceIndex) const;
+
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+    int sortColumn() const { return sortCol; }
+    Qt::SortOrder sortOrder() const { return order; }
+
+    void setFilterFixedString(const QString&);
+
+    // source row comparison using the current sort column and order
+    bool lessThan(int left, int right) const;
+
+private slots:
+    void sourceRowsInserted(const QModelIndex&, int, int);
+    void sourceRowsAboutToBeRemoved(const QModelIndex&, int, int);
+    void sourceRowsRemoved(const QModelIndex&, int, int);
+    void sourceRowsAboutToBeErased(const QVector<bool>&);
+    void sourceRowsErased(const QVector<bool>&);
+    void sourceDataChanged(const QModelIndex&, const QModelIndex&);
+    void sourceAboutToBeReset();
+    void sourceReset();
+    void sourceColumnsAboutToBeInserted(const QModelIndex&, int, int);
+    void sourceColumnsInserted(const QModelIndex&, int, int);
+    void sourceColumnsAboutToBeRemoved(const QModelIndex&, int, int);
+    void sourceColumnsRemoved(const QModelIndex&, int, int);
+    void sourceRowShownChanged(int);
+    void refilter();
+
+private:
+    QueueTableModel* queues;
+
+    // proxy row -> source row, in display order
+    QVector<int> proxyRows;
+    // source row -> proxy row, -1 for rows that are filtered out
+    QVector<int> sourceRows;
+
+    int             sortCol;
+    Qt::SortOrder   order;
+    QString         filter;
+    // trigrams of the source rows' queue names
+    NGramIndex      names;
+
+    bool accepts(int sourceRow) const;
+    void matchingRows(QVector<int>&) const;
+    void reindex();
+    void remap();
+    void rebuild();
+    void relayout();
+    void insertSourceRows(QVector<int>);
+    void removeProxyRows(const QVector<bool>&);
+    int  reposition(int proxyRow);
+};
+
+#endif
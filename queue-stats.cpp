@@ -0,0 +1,285 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "queue-stats.h"
+#include "row-runs.h"
+
+static const char* propertyNames[QP_COUNT] = {
+    "name",
+    "autoDelete",
+    "msgDepth",
+    "byteDepth",
+    "msgTotalEnqueues",
+    "msgTotalDequeues",
+    "byteTotalEnqueues",
+    "byteTotalDequeues",
+    "consumerCount",
+    "msgInRate",
+    "msgOutRate",
+    "byteInRate",
+    "byteOutRate"
+};
+
+// the counters kept in each queue's history, by history slot
+static const QueueProperty historyProperties[QueueHistory::VALUES] = {
+    QP_MSG_DEPTH,
+    QP_BYTE_DEPTH,
+    QP_MSG_ENQUEUES,
+    QP_MSG_DEQUEUES,
+    QP_BYTE_ENQUEUES,
+    QP_BYTE_DEQUEUES
+};
+
+// the history slot each rate is worked out from
+static const int RATE_COUNT = QP_COUNT - QP_FIRST_DERIVED;
+static const int rateSources[RATE_COUNT] = { 2, 3, 4, 5 };
+
+// rates are averaged over this many history intervals
+static const int RATE_SPAN = 3;
+// the least msecs between two history samples
+static const qint64 HISTORY_GAP = 1000;
+
+const char* queuePropertyName(QueueProperty p)
+{
+    return propertyNames[p];
+}
+
+// Pull the properties we keep out of a queue object
+QueueSample QueueSample::fromData(const qmf::Data& queue, qint64 time)
+{
+    QueueSample sample;
+    sample.time = time;
+    const qpid::types::Variant::Map& attrs(queue.getProperties());
+    qpid::types::Variant::Map::const_iterator iter;
+
+    if (queue.hasAddr()) {
+        sample.addr = queue.getAddr();
+        sample.objectName = QString(sample.addr.getName().c_str());
+    }
+
+    iter = attrs.find(propertyNames[QP_NAME]);
+    if (iter != attrs.end()) {
+        sample.name = QString(iter->second.asString().c_str());
+        sample.present |= 1 << QP_NAME;
+    }
+    if (sample.objectName.isEmpty())
+        sample.objectName = sample.name;
+
+    for (int p = QP_NAME + 1; p < QP_COUNT; p++) {
+        sample.values[p] = 0;
+        if (p >= QP_FIRST_DERIVED)
+            continue;
+        iter = attrs.find(propertyNames[p]);
+        if (iter != attrs.end()) {
+            if (iter->second.getType() == qpid::types::VAR_BOOL)
+                sample.values[p] = iter->second.asBool() ? 1 : 0;
+            else
+                sample.values[p] = iter->second.asUint64();
+            sample.present |= 1 << p;
+        }
+    }
+    return sample;
+}
+
+// Boolean properties were exported as words
+QueueSample QueueSample::fromText(const QString& name, const QHash<QString, QString>& properties, qint64 time)
+{
+    QueueSample sample;
+    sample.time = time;
+    sample.name = name;
+    sample.objectName = name;
+    sample.present |= 1 << QP_NAME;
+
+    for (int p = QP_NAME + 1; p < QP_COUNT; p++) {
+        sample.values[p] = 0;
+        if (p >= QP_FIRST_DERIVED)
+            continue;
+        QHash<QString, QString>::const_iterator iter = properties.find(propertyNames[p]);
+        if (iter == properties.end())
+            continue;
+        bool ok;
+        quint64 value = iter.value().toULongLong(&ok);
+        if (ok)
+            sample.values[p] = value;
+        else if (iter.value().compare("true", Qt::CaseInsensitive) == 0)
+            sample.values[p] = 1;
+        else if (iter.value().compare("false", Qt::CaseInsensitive) != 0)
+            continue;
+        sample.present |= 1 << p;
+    }
+    return sample;
+}
+
+int QueueStats::append(const QueueSample& sample, uint correlator)
+{
+    int row = nameIds.size();
+    nameIds.append(names.intern(sample.name));
+    objectNameIds.append(names.intern(sample.objectName));
+    addrs.append(sample.addr);
+    correlators.append(correlator);
+    present.append(sample.present);
+    for (int p = QP_NAME + 1; p < QP_COUNT; p++)
+        counters[p].append(sample.values[p]);
+    history.append(QueueHistory());
+    record(row, sample.time);
+    return row;
+}
+
+// Copy the properties carried by sample into row. Returns a bit mask of
+// the properties whose value changed.
+quint32 QueueStats::update(int row, const QueueSample& sample)
+{
+    quint32 changed = 0;
+
+    if (sample.has(QP_NAME) && (!has(row, QP_NAME) || name(row) != sample.name)) {
+        quint32 id = names.intern(sample.name);
+        names.release(nameIds[row]);
+        nameIds[row] = id;
+        changed |= 1 << QP_NAME;
+    }
+    for (int p = QP_NAME + 1; p < QP_FIRST_DERIVED; p++) {
+        if (!sample.has((QueueProperty)p))
+            continue;
+        if (!has(row, (QueueProperty)p) || counters[p][row] != sample.values[p]) {
+            counters[p][row] = sample.values[p];
+            changed |= 1 << p;
+        }
+    }
+    present[row] |= sample.present;
+
+    // an unchanged counter still goes in the history, its rate drops
+    changed |= record(row, sample.time);
+    return changed;
+}
+
+// Add the row's counters to its history and work out its rates again.
+// Returns a bit mask of the rates that changed.
+quint32 QueueStats::record(int row, qint64 time)
+{
+    quint64 values[QueueHistory::VALUES];
+    for (int which = 0; which < QueueHistory::VALUES; which++)
+        values[which] = counters[historyProperties[which]][row];
+
+    QueueHistory& recent(history[row]);
+    recent.record(time, values, HISTORY_GAP);
+
+    quint32 changed = 0;
+    for (int idx = 0; idx < RATE_COUNT; idx++) {
+        int p = QP_FIRST_DERIVED + idx;
+        quint64 rate;
+        if (!has(row, historyProperties[rateSources[idx]]) ||
+            !recent.rate(rateSources[idx], RATE_SPAN, rate))
+            continue;
+        if (!has(row, (QueueProperty)p) || counters[p][row] != rate) {
+            counters[p][row] = rate;
+            changed |= 1 << p;
+        }
+        present[row] |= 1 << p;
+    }
+    return changed;
+}
+
+bool QueueStats::hasTrend(QueueProperty p)
+{
+    return p == QP_MSG_DEPTH || p == QP_BYTE_DEPTH || p >= QP_FIRST_DERIVED;
+}
+
+// Depths come straight from the history. A rate is worked out for each
+// interval in it.
+QVector<quint64> QueueStats::trend(int row, QueueProperty p) const
+{
+    QVector<quint64> points;
+    const QueueHistory& recent(history[row]);
+
+    if (p >= QP_FIRST_DERIVED) {
+        int which = rateSources[p - QP_FIRST_DERIVED];
+        for (int idx = 1; idx < recent.count(); idx++)
+            points.append(recent.rateAt(idx, which));
+    } else if (hasTrend(p)) {
+        int which = p == QP_MSG_DEPTH ? 0 : 1;
+        for (int idx = 0; idx < recent.count(); idx++)
+            points.append(recent.value(idx, which));
+    }
+    return points;
+}
+
+// A row's references to its names
+void QueueStats::release(int row)
+{
+    names.release(nameIds[row]);
+    names.release(objectNameIds[row]);
+}
+
+void QueueStats::remove(int first, int last)
+{
+    int count = last - first + 1;
+    for (int row = first; row <= last; row++)
+        release(row);
+    nameIds.remove(first, count);
+    objectNameIds.remove(first, count);
+    addrs.remove(first, count);
+    correlators.remove(first, count);
+    present.remove(first, count);
+    for (int p = QP_NAME + 1; p < QP_COUNT; p++)
+        counters[p].remove(first, count);
+    history.remove(first, count);
+}
+
+// Remove every row whose flag is set in one pass over each column
+void QueueStats::removeFlagged(const QVector<bool>& flagged)
+{
+    for (int row = 0; row < flagged.size(); row++)
+        if (flagged[row])
+            release(row);
+    eraseFlagged(nameIds, flagged);
+    eraseFlagged(objectNameIds, flagged);
+    eraseFlagged(addrs, flagged);
+    eraseFlagged(correlators, flagged);
+    eraseFlagged(present, flagged);
+    for (int p = QP_NAME + 1; p < QP_COUNT; p++)
+        eraseFlagged(counters[p], flagged);
+    eraseFlagged(history, flagged);
+}
+
+void QueueStats::clear()
+{
+    names.clear();
+    nameIds.clear();
+    objectNameIds.clear();
+    addrs.clear();
+    correlators.clear();
+    present.clear();
+    for (int p = QP_NAME + 1; p < QP_COUNT; p++)
+        counters[p].clear();
+    history.clear();
+}
+
+// The fixed cost of one queue in the store, not counting its entries in
+// the name table
+size_t QueueStats::bytesPerQueue()
+{
+    return 2 * sizeof(quint32) + sizeof(qmf::DataAddr) + sizeof(uint) +
+           sizeof(quint32) + (QP_COUNT - 1) * sizeof(quint64) +
+           sizeof(QueueHistory);
+}
+
+size_t QueueStats::memoryUsage() const
+{
+    return size() * bytesPerQueue() + names.memoryUsage();
+}
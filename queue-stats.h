@@ -0,0 +1,131 @@
+#ifndef _qe_queue_stats_h
+#define _qe_queue_stats_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QMetaType>
+#include <qmf/Data.h>
+#include <qmf/DataAddr.h>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include "queue-history.h"
+#include "name-table.h"
+
+// The queue properties kept by the queue table. Everything else in a
+// queue's qmf::Data is dropped once these have been extracted. The rates
+// at the end are worked out from each queue's history.
+typedef enum {
+    QP_NAME,
+    QP_AUTO_DELETE,
+    QP_MSG_DEPTH,
+    QP_BYTE_DEPTH,
+    QP_MSG_ENQUEUES,
+    QP_MSG_DEQUEUES,
+    QP_BYTE_ENQUEUES,
+    QP_BYTE_DEQUEUES,
+    QP_CONSUMERS,
+    QP_MSG_IN_RATE,
+    QP_MSG_OUT_RATE,
+    QP_BYTE_IN_RATE,
+    QP_BYTE_OUT_RATE,
+    QP_COUNT
+} QueueProperty;
+
+// the first property that isn't read from the broker
+const int QP_FIRST_DERIVED = QP_MSG_IN_RATE;
+
+const char* queuePropertyName(QueueProperty);
+
+//
+// The properties of one queue as reported by one update. present has a
+// bit set for each property the update carried.
+//
+struct QueueSample {
+    QString         name;
+    QString         objectName;     // QMF object name, the key for updates
+    qmf::DataAddr   addr;
+    quint32         present;
+    quint64         values[QP_COUNT];
+    qint64          time;           // msecs on the QMF thread's clock when received
+
+    QueueSample() : present(0), time(0) {}
+    static QueueSample fromData(const qmf::Data&, qint64 time);
+    // from the property name -> value text of an export
+    static QueueSample fromText(const QString& name, const QHash<QString, QString>& properties, qint64 time);
+
+    bool has(QueueProperty p) const { return present & (1 << p); }
+};
+
+// The queues from one query response or one slice of pushed updates,
+// built by the QMF thread and shared read-only with the GUI thread
+typedef boost::shared_ptr<const std::vector<QueueSample> > QueueSampleBatch;
+Q_DECLARE_METATYPE(QueueSampleBatch);
+
+//
+// Statistics for all the queues in the table, stored column-wise: one
+// vector per property, indexed by row. Reading a value is an array index,
+// no qpid::types::Variant is kept. The names are interned, a row only
+// holds their ids.
+//
+class QueueStats {
+public:
+    int size() const { return nameIds.size(); }
+
+    int append(const QueueSample&, uint correlator);
+    quint32 update(int row, const QueueSample&);
+    void remove(int first, int last);
+    void removeFlagged(const QVector<bool>&);
+    void clear();
+
+    const QString& name(int row) const { return names.text(nameIds[row]); }
+    const QString& objectName(int row) const { return names.text(objectNameIds[row]); }
+    quint32 objectNameId(int row) const { return objectNameIds[row]; }
+    // the names of all the rows
+    const NameTable& nameTable() const { return names; }
+    const qmf::DataAddr& addr(int row) const { return addrs[row]; }
+    bool has(int row, QueueProperty p) const { return present[row] & (1 << p); }
+    quint64 value(int row, QueueProperty p) const { return counters[p][row]; }
+    uint correlator(int row) const { return correlators[row]; }
+    void setCorrelator(int row, uint c) { correlators[row] = c; }
+
+    // the recent values of a depth or rate, oldest first
+    QVector<quint64> trend(int row, QueueProperty) const;
+    static bool hasTrend(QueueProperty);
+
+    static size_t bytesPerQueue();
+    size_t memoryUsage() const;
+
+private:
+    NameTable               names;
+    QVector<quint32>        nameIds;
+    QVector<quint32>        objectNameIds;
+    QVector<qmf::DataAddr>  addrs;
+    QVector<uint>           correlators;
+    QVector<quint32>        present;
+    QVector<quint64>        counters[QP_COUNT];     // counters[QP_NAME] is unused
+    QVector<QueueHistory>   history;
+
+    quint32 record(int row, qint64 time);
+    void release(int row);
+};
+
+#endif
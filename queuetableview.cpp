@@ -30,21 +30,7 @@ bool QueueTableView::hasSelected()
     return index.row() >= 0;
 }
 
-const qmf::Data& QueueTableView::selectedQueue(QueueTableModel *model, QSortFilterProxyModel *proxy)
-{
-    QModelIndex index = currentIndex();
-    QModelIndex sindex = proxy->mapToSource(index);
-    return model->selectedQueue(sindex);
-}
-
-const qmf::Agent& QueueTableView::selectedQueueAgent(QueueTableModel *model, QSortFilterProxyModel *proxy)
-{
-    QModelIndex index = currentIndex();
-    QModelIndex sindex = proxy->mapToSource(index);
-    return model->selectedQueueAgent(sindex);
-}
-
-QString QueueTableView::selectedQueueName(QueueTableModel *model, QSortFilterProxyModel *proxy)
+QString QueueTableView::selectedQueueName(QueueTableModel *model, QAbstractProxyModel *proxy)
 {
     QModelIndex index = currentIndex();
     if (index.isValid()) {
@@ -54,14 +40,14 @@ QString QueueTableView::selectedQueueName(QueueTableModel *model, QSortFilterPro
     return QString();
 }
 
-const qmf::DataAddr& QueueTableView::selectedQueueDataAddr(QueueTableModel *model, QSortFilterProxyModel *proxy)
+const qmf::DataAddr& QueueTableView::selectedQueueDataAddr(QueueTableModel *model, QAbstractProxyModel *proxy)
 {
     QModelIndex index = currentIndex();
     QModelIndex sindex = proxy->mapToSource(index);
     return model->selectedQueueDataAddr(sindex);
 }
 
-QVariant QueueTableView::selectedQueueDepth(QueueTableModel *model, QSortFilterProxyModel *proxy)
+QVariant QueueTableView::selectedQueueDepth(QueueTableModel *model, QAbstractProxyModel *proxy)
 {
     QModelIndex index = currentIndex();
     if (index.isValid()) {
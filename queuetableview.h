@@ -21,7 +21,7 @@
 #define QUEUETABLEVIEW_H
 
 #include <QTableView>
-#include <QSortFilterProxyModel>
+#include <QAbstractProxyModel>
 #include "model-queue.h"
 
 class QueueTableView : public QTableView
@@ -30,11 +30,9 @@ class QueueTableView : public QTableView
 public:
     explicit QueueTableView(QWidget *parent = 0);
 
-    QString                 selectedQueueName(QueueTableModel *, QSortFilterProxyModel *);
-    const qmf::Data&        selectedQueue(QueueTableModel *, QSortFilterProxyModel *);
-    const qmf::Agent&       selectedQueueAgent(QueueTableModel *, QSortFilterProxyModel *);
-    const qmf::DataAddr&    selectedQueueDataAddr(QueueTableModel *, QSortFilterProxyModel *);
-    QVariant                selectedQueueDepth(QueueTableModel *, QSortFilterProxyModel *);
+    QString                 selectedQueueName(QueueTableModel *, QAbstractProxyModel *);
+    const qmf::DataAddr&    selectedQueueDataAddr(QueueTableModel *, QAbstractProxyModel *);
+    QVariant                selectedQueueDepth(QueueTableModel *, QAbstractProxyModel *);
 
     bool                    hasSelected();
 
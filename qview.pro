@@ -17,7 +17,24 @@ SOURCES += main.cpp\
     dialogabout.cpp \
     dialogpurge.cpp \
     queuetableview.cpp \
-    dialogcopy.cpp
+    dialogcopy.cpp \
+    refresh-scheduler.cpp \
+    queue-stats.cpp \
+    header-preparer.cpp \
+    queue-proxy.cpp \
+    top-tracker.cpp \
+    queue-history.cpp \
+    sparkline-delegate.cpp \
+    stats-recorder.cpp \
+    stats-player.cpp \
+    prefix-matcher.cpp \
+    ngram-index.cpp \
+    queue-exporter.cpp \
+    export-job.cpp \
+    snapshot-writer.cpp \
+    snapshot-reader.cpp \
+    offline-source.cpp \
+    name-table.cpp
 
 HEADERS  += \
     main.h \
@@ -28,7 +45,25 @@ HEADERS  += \
     dialogabout.h \
     dialogpurge.h \
     queuetableview.h \
-    dialogcopy.h
+    dialogcopy.h \
+    refresh-scheduler.h \
+    queue-stats.h \
+    header-preparer.h \
+    row-runs.h \
+    queue-proxy.h \
+    top-tracker.h \
+    queue-history.h \
+    sparkline-delegate.h \
+    stats-recorder.h \
+    stats-player.h \
+    prefix-matcher.h \
+    ngram-index.h \
+    queue-exporter.h \
+    export-job.h \
+    snapshot-writer.h \
+    snapshot-reader.h \
+    offline-source.h \
+    name-table.h
 
 FORMS    += \
     qview_main.ui \
@@ -0,0 +1,121 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "refresh-scheduler.h"
+
+RefreshScheduler::RefreshScheduler() : minimum(0)
+{
+    for (int t = 0; t < TIMER_COUNT; t++) {
+        timers[t].base = 1000;
+        timers[t].max = 1000;
+        timers[t].current = 1000;
+        timers[t].last = 0;
+        timers[t].due = 0;
+        timers[t].enabled = false;
+    }
+}
+
+// the shortest interval a timer may use
+qint64 RefreshScheduler::floor(const Entry& entry) const
+{
+    return qMax(entry.base, minimum);
+}
+
+void RefreshScheduler::setInterval(Timer t, qint64 base, qint64 max)
+{
+    Entry& entry(timers[t]);
+    entry.base = base;
+    entry.max = qMax(base, max);
+    entry.current = base;
+}
+
+void RefreshScheduler::setMinimumInterval(qint64 msecs)
+{
+    minimum = msecs;
+    for (int t = 0; t < TIMER_COUNT; t++) {
+        Entry& entry(timers[t]);
+        entry.current = qMax(entry.current, floor(entry));
+        entry.due = qMax(entry.due, entry.last + minimum);
+    }
+}
+
+// Start a timer at its fastest rate, firing right away
+void RefreshScheduler::start(Timer t, qint64 now)
+{
+    Entry& entry(timers[t]);
+    entry.enabled = true;
+    entry.current = floor(entry);
+    entry.due = now;
+}
+
+void RefreshScheduler::stop(Timer t)
+{
+    timers[t].enabled = false;
+}
+
+// Something happened that makes a refresh worthwhile. Fire as soon as the
+// minimum interval allows and go back to the fastest rate.
+void RefreshScheduler::trigger(Timer t, qint64 now)
+{
+    Entry& entry(timers[t]);
+    if (!entry.enabled)
+        return;
+    entry.current = floor(entry);
+    entry.due = qMin(entry.due, qMax(now, entry.last + minimum));
+}
+
+bool RefreshScheduler::isDue(Timer t, qint64 now) const
+{
+    const Entry& entry(timers[t]);
+    return entry.enabled && now >= entry.due;
+}
+
+void RefreshScheduler::fired(Timer t, qint64 now)
+{
+    Entry& entry(timers[t]);
+    entry.last = now;
+    entry.due = now + entry.current;
+}
+
+// Adjust the interval once the outcome of a refresh is known
+void RefreshScheduler::result(Timer t, bool changed)
+{
+    Entry& entry(timers[t]);
+    qint64 previous = entry.current;
+    if (changed)
+        entry.current = floor(entry);
+    else
+        entry.current = qMin(entry.current * 2, qMax(entry.max, floor(entry)));
+    entry.due += entry.current - previous;
+}
+
+// How long until the next enabled timer fires, or -1 if none are enabled
+qint64 RefreshScheduler::msecsUntilNext(qint64 now) const
+{
+    qint64 next = -1;
+    for (int t = 0; t < TIMER_COUNT; t++) {
+        const Entry& entry(timers[t]);
+        if (entry.enabled) {
+            qint64 wait = qMax(entry.due - now, (qint64)0);
+            if (next < 0 || wait < next)
+                next = wait;
+        }
+    }
+    return next;
+}
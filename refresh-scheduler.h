@@ -0,0 +1,66 @@
+#ifndef _qe_refresh_scheduler_h
+#define _qe_refresh_scheduler_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <QtGlobal>
+
+//
+// Decides when the QMF thread should next refresh each kind of data.
+// Each timer backs off towards its maximum interval while refreshes
+// turn up nothing new and drops back to its base interval as soon as
+// something changes. No timer fires more often than the minimum interval.
+// All times are msecs on the caller's clock.
+//
+class RefreshScheduler {
+public:
+    typedef enum { QUEUE_LIST, HEADERS, STATISTICS, TIMER_COUNT } Timer;
+
+    RefreshScheduler();
+
+    void setInterval(Timer, qint64 base, qint64 max);
+    void setMinimumInterval(qint64);
+    qint64 minimumInterval() const { return minimum; }
+
+    void start(Timer, qint64 now);
+    void stop(Timer);
+    void trigger(Timer, qint64 now);
+
+    bool isDue(Timer, qint64 now) const;
+    void fired(Timer, qint64 now);
+    void result(Timer, bool changed);
+    qint64 msecsUntilNext(qint64 now) const;
+
+private:
+    struct Entry {
+        qint64 base;
+        qint64 max;
+        qint64 current;     // interval in use, between base and max
+        qint64 last;        // when the timer last fired
+        qint64 due;
+        bool   enabled;
+    };
+
+    Entry   timers[TIMER_COUNT];
+    qint64  minimum;
+
+    qint64 floor(const Entry&) const;
+};
+
+#endif
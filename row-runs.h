@@ -0,0 +1,89 @@
+#ifndef _qe_row_runs_h
+#define _qe_row_runs_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <vector>
+#include <utility>
+
+//
+// Helpers for removing many rows from a model at once. The flagged rows
+// are grouped into contiguous runs so the views see one removal per run.
+// When there are more runs than MAX_REMOVE_RUNS the rows are dropped with
+// eraseFlagged() in one pass inside a single layout change, and the
+// persistent indexes are moved with keptRows().
+//
+const int MAX_REMOVE_RUNS = 32;
+
+// first and last row of a run
+typedef std::pair<int, int> RowRun;
+typedef std::vector<RowRun> RowRunList;
+
+// The runs of flagged rows, last run first so removing them in order
+// leaves the row numbers of the runs still to go unchanged
+template <class Flags>
+RowRunList flaggedRuns(const Flags& flagged)
+{
+    RowRunList runs;
+    int row = (int)flagged.size() - 1;
+    while (row >= 0) {
+        if (!flagged[row]) {
+            --row;
+            continue;
+        }
+        int last = row;
+        while (row >= 0 && flagged[row])
+            --row;
+        runs.push_back(RowRun(row + 1, last));
+    }
+    return runs;
+}
+
+// Remove the flagged entries, keeping the order of the rest. Every entry
+// is moved at most once.
+template <class Container, class Flags>
+void eraseFlagged(Container& items, const Flags& flagged)
+{
+    int kept = 0;
+    for (int idx = 0; idx < (int)flagged.size(); idx++) {
+        if (flagged[idx])
+            continue;
+        if (kept != idx)
+            items[kept] = items[idx];
+        ++kept;
+    }
+    items.resize(kept);
+}
+
+// The row each row moves to once the flagged rows are erased, -1 for the
+// flagged rows themselves
+template <class Flags>
+std::vector<int> keptRows(const Flags& flagged)
+{
+    std::vector<int> rows(flagged.size(), -1);
+    int kept = 0;
+    for (int idx = 0; idx < (int)flagged.size(); idx++) {
+        if (!flagged[idx])
+            rows[idx] = kept++;
+    }
+    return rows;
+}
+
+#endif
@@ -0,0 +1,319 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "snapshot-reader.h"
+#include "snapshot-writer.h"
+#include <cstring>
+#include <climits>
+#include <algorithm>
+
+// An XML export starts with this, and each message with MESSAGE_START
+static const char QUEUE_START[] = "<queue";
+static const char MESSAGE_START[] = "\n  <message sequence=\"";
+
+SnapshotReader::SnapshotReader() : data(0), size(0), format(FORMAT_SNAPSHOT), index(0), count(0), xmlEnd(0)
+{
+}
+
+SnapshotReader::~SnapshotReader()
+{
+    close();
+}
+
+bool SnapshotReader::fail(const QString& reason)
+{
+    close();
+    error = reason;
+    return false;
+}
+
+bool SnapshotReader::open(const QString& path)
+{
+    close();
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+    size = file.size();
+    data = size > 0 ? file.map(0, size) : 0;
+    if (!data)
+        return fail(size > 0 ? file.errorString() : QString("The file is empty"));
+
+    if (size >= (qint64)strlen(QUEUE_START) && memcmp(data, QUEUE_START, strlen(QUEUE_START)) == 0)
+        return openXml();
+
+    qint64 offset = sizeof(SNAPSHOT_MAGIC);
+    quint32 order;
+    if (size < offset || memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+        !read(offset, order) || order != SNAPSHOT_BYTE_ORDER)
+        return fail("Not a queue snapshot from this kind of machine");
+
+    // an export that didn't finish has no trailer
+    quint64 indexOffset;
+    offset = size - sizeof(SNAPSHOT_END) - sizeof(indexOffset);
+    if (offset < 0 || !read(offset, indexOffset) ||
+        memcmp(data + offset, SNAPSHOT_END, sizeof(SNAPSHOT_END)) != 0)
+        return fail("The snapshot is incomplete");
+
+    qint64 end;
+    quint64 queueOffset;
+    quint64 messages;
+    offset = indexOffset;
+    if (indexOffset >= (quint64)size || !readRecord(offset, SNAP_INDEX, end) ||
+        !read(offset, queueOffset) || !read(offset, messages) ||
+        offset > end || messages > (quint64)(end - offset) / sizeof(quint64) || messages > (quint64)INT_MAX)
+        return fail("The snapshot index is damaged");
+    index = offset;
+    count = messages;
+
+    offset = queueOffset;
+    if (queueOffset >= (quint64)size || !readRecord(offset, SNAP_QUEUE, end) ||
+        !readString(offset, name) || !readFields(offset, properties) || offset > end)
+        return fail("The snapshot's queue record is damaged");
+
+    return true;
+}
+
+void SnapshotReader::close()
+{
+    if (data)
+        file.unmap(const_cast<uchar*>(data));
+    file.close();
+    data = 0;
+    size = 0;
+    name.clear();
+    properties.clear();
+    format = FORMAT_SNAPSHOT;
+    index = 0;
+    count = 0;
+    xmlMessages.clear();
+    xmlEnd = 0;
+}
+
+// The offsets come from the file, so they are checked without any sum
+// that could overflow
+template <class T>
+bool SnapshotReader::read(qint64& offset, T& value) const
+{
+    if (offset < 0 || offset > size - (qint64)sizeof(T))
+        return false;
+    memcpy(&value, data + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+bool SnapshotReader::readString(qint64& offset, QString& text) const
+{
+    quint32 length;
+    if (!read(offset, length) || length > size - offset)
+        return false;
+    text = QString::fromUtf8((const char*)data + offset, length);
+    offset += length;
+    return true;
+}
+
+bool SnapshotReader::readFields(qint64& offset, SnapshotFields& fields) const
+{
+    quint32 fieldCount;
+    if (!read(offset, fieldCount))
+        return false;
+    fields.clear();
+    for (quint32 idx = 0; idx < fieldCount; idx++) {
+        QPair<QString, QString> field;
+        if (!readString(offset, field.first) || !readString(offset, field.second))
+            return false;
+        fields.append(field);
+    }
+    return true;
+}
+
+// Check the record at offset is of the type expected and fits in the
+// file. offset is left at its payload, and end just after it.
+bool SnapshotReader::readRecord(qint64& offset, char type, qint64& end) const
+{
+    quint8 recordType;
+    quint32 length;
+    if (!read(offset, recordType) || recordType != (quint8)type || !read(offset, length))
+        return false;
+    end = offset + length;
+    return end <= size;
+}
+
+bool SnapshotReader::headerOffset(int idx, qint64& offset) const
+{
+    if (!data || idx < 0 || idx >= count)
+        return false;
+    quint64 value;
+    qint64 entry = index + (qint64)idx * sizeof(quint64);
+    if (!read(entry, value) || value >= (quint64)size)
+        return false;
+    offset = value;
+    return true;
+}
+
+bool SnapshotReader::message(int idx, SnapshotMessage& message) const
+{
+    if (format == FORMAT_XML) {
+        qint64 start;
+        qint64 end;
+        if (!xmlMessage(idx, start, end))
+            return false;
+        start += strlen(MESSAGE_START) - 1;
+        qint64 quote = find("\"", start, end);
+        if (quote < 0)
+            return false;
+        message.messageId = QString::fromUtf8((const char*)data + start, quote - start);
+
+        message.arguments.clear();
+        qint64 args = find("<arguments>", quote, end);
+        if (args >= 0)
+            readXmlFields(args, find("</arguments>", args, end), message.arguments);
+        message.contentType.clear();
+        for (int field = 0; field < message.arguments.size(); field++)
+            if (message.arguments[field].first == "ContentType")
+                message.contentType = message.arguments[field].second;
+        return true;
+    }
+
+    qint64 offset;
+    qint64 end;
+    return headerOffset(idx, offset) && readRecord(offset, SNAP_HEADER, end) &&
+        readString(offset, message.messageId) && readString(offset, message.contentType) &&
+        readFields(offset, message.arguments) && offset <= end;
+}
+
+// The body record follows its header
+QString SnapshotReader::body(int idx) const
+{
+    qint64 offset;
+    qint64 end;
+    QString text;
+
+    // the body isn't escaped, so it runs to the last </body> of the message
+    if (format == FORMAT_XML) {
+        if (!xmlMessage(idx, offset, end))
+            return QString();
+        qint64 args = find("</arguments>", offset, end);
+        offset = find("<body>", args < 0 ? offset : args, end);
+        if (offset < 0)
+            return QString();
+        offset += strlen("<body>");
+        end = findLast("</body>", offset, end);
+        if (end < 0)
+            return QString();
+        return QString::fromUtf8((const char*)data + offset, end - offset);
+    }
+
+    if (!headerOffset(idx, offset) || !readRecord(offset, SNAP_HEADER, end))
+        return QString();
+    offset = end;
+    if (!readRecord(offset, SNAP_BODY, end) || !readString(offset, text))
+        return QString();
+    return text;
+}
+
+// Find where the queue's properties are and where each message starts.
+// Nothing in an XML export is escaped, so it is read by its layout
+// rather than parsed.
+bool SnapshotReader::openXml()
+{
+    format = FORMAT_XML;
+
+    qint64 tagEnd = find(">", 0, size);
+    qint64 messages = find("<messages>", 0, size);
+    xmlEnd = findLast("</messages>", 0, size);
+    if (tagEnd < 0 || messages < 0 || xmlEnd < messages)
+        return fail("The export is incomplete");
+
+    qint64 nameStart = find("name=\"", 0, tagEnd);
+    if (nameStart >= 0) {
+        nameStart += strlen("name=\"");
+        qint64 nameEnd = find("\"", nameStart, tagEnd);
+        if (nameEnd >= 0)
+            name = QString::fromUtf8((const char*)data + nameStart, nameEnd - nameStart);
+    }
+
+    qint64 props = find("<properties>", tagEnd, messages);
+    if (props >= 0)
+        readXmlFields(props, find("</properties>", props, messages), properties);
+
+    for (qint64 offset = find(MESSAGE_START, messages, xmlEnd); offset >= 0;
+         offset = find(MESSAGE_START, offset + 1, xmlEnd))
+        xmlMessages.append(offset + 1);
+    count = xmlMessages.size();
+    return true;
+}
+
+// Offset of text in [from, to), or -1
+qint64 SnapshotReader::find(const char* text, qint64 from, qint64 to) const
+{
+    if (from < 0 || to < 0)
+        return -1;
+    const char* begin = (const char*)data + from;
+    const char* end = (const char*)data + to;
+    const char* found = std::search(begin, end, text, text + strlen(text));
+    return found == end ? -1 : found - (const char*)data;
+}
+
+qint64 SnapshotReader::findLast(const char* text, qint64 from, qint64 to) const
+{
+    if (from < 0 || to < 0)
+        return -1;
+    const char* begin = (const char*)data + from;
+    const char* end = (const char*)data + to;
+    const char* found = std::find_end(begin, end, text, text + strlen(text));
+    return found == end ? -1 : found - (const char*)data;
+}
+
+// The <name> and <value> pairs in [from, to)
+void SnapshotReader::readXmlFields(qint64 from, qint64 to, SnapshotFields& fields) const
+{
+    fields.clear();
+    if (to < 0)
+        return;
+    for (;;) {
+        qint64 nameStart = find("<name>", from, to);
+        qint64 nameEnd = find("</name>", nameStart, to);
+        qint64 valueStart = find("<value>", nameEnd, to);
+        qint64 valueEnd = find("</value>", valueStart, to);
+        if (valueEnd < 0)
+            return;
+        nameStart += strlen("<name>");
+        valueStart += strlen("<value>");
+
+        QPair<QString, QString> field;
+        field.first = QString::fromUtf8((const char*)data + nameStart, nameEnd - nameStart);
+        field.second = QString::fromUtf8((const char*)data + valueStart, valueEnd - valueStart);
+        fields.append(field);
+        from = valueEnd;
+    }
+}
+
+// A message runs to the start of the next one
+bool SnapshotReader::xmlMessage(int idx, qint64& start, qint64& end) const
+{
+    if (!data || idx < 0 || idx >= count)
+        return false;
+    start = xmlMessages[idx];
+    end = idx + 1 < count ? xmlMessages[idx + 1] : xmlEnd;
+    return true;
+}
@@ -0,0 +1,97 @@
+#ifndef _qe_snapshot_reader_h
+#define _qe_snapshot_reader_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include <QFile>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+typedef QVector<QPair<QString, QString> > SnapshotFields;
+
+// A message's header as it was exported
+struct SnapshotMessage {
+    QString         messageId;
+    QString         contentType;
+    SnapshotFields  arguments;
+};
+
+//
+// Reads a snapshot written by SnapshotWriter, or an XML export. The file
+// is memory mapped and only the header, trailer and queue record of a
+// snapshot are read when it is opened; a message is found through the
+// index when it is asked for, so opening a large snapshot or going to its
+// last message costs the same as a small one. An XML export has no index,
+// so opening one scans it once for where each message starts.
+//
+class SnapshotReader {
+public:
+    SnapshotReader();
+    ~SnapshotReader();
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return data != 0; }
+    QString errorString() const { return error; }
+
+    const QString& queueName() const { return name; }
+    const SnapshotFields& queueProperties() const { return properties; }
+
+    int messageCount() const { return count; }
+    bool message(int idx, SnapshotMessage&) const;
+    QString body(int idx) const;
+
+    bool isXml() const { return format == FORMAT_XML; }
+
+private:
+    typedef enum { FORMAT_SNAPSHOT, FORMAT_XML } Format;
+
+    QFile           file;
+    const uchar*    data;
+    qint64          size;
+    QString         error;
+
+    QString         name;
+    SnapshotFields  properties;
+    Format          format;
+    qint64          index;      // offset of the first header offset
+    int             count;
+
+    // XML: where each <message> starts, and the end of the last one
+    QVector<qint64> xmlMessages;
+    qint64          xmlEnd;
+
+    template <class T> bool read(qint64& offset, T& value) const;
+    bool readString(qint64& offset, QString&) const;
+    bool readFields(qint64& offset, SnapshotFields&) const;
+    bool readRecord(qint64& offset, char type, qint64& end) const;
+    bool headerOffset(int idx, qint64& offset) const;
+    bool fail(const QString&);
+
+    bool openXml();
+    qint64 find(const char* text, qint64 from, qint64 to) const;
+    qint64 findLast(const char* text, qint64 from, qint64 to) const;
+    void readXmlFields(qint64 from, qint64 to, SnapshotFields&) const;
+    bool xmlMessage(int idx, qint64& start, qint64& end) const;
+};
+
+#endif
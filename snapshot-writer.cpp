@@ -0,0 +1,152 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "snapshot-writer.h"
+#include <QFileInfo>
+#include <sstream>
+#include <cstring>
+
+const char SNAPSHOT_MAGIC[8] = { 'Q', 'V', 'S', 'N', 'A', 'P', '0', '1' };
+const char SNAPSHOT_END[8] = { 'Q', 'V', 'S', 'N', 'A', 'P', 'I', 'X' };
+const char SNAPSHOT_SUFFIX[] = "qvsnap";
+
+template <class T>
+static void put(QByteArray& buffer, const T& value)
+{
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void putString(QByteArray& buffer, const std::string& text)
+{
+    put(buffer, (quint32)text.size());
+    buffer.append(text.data(), text.size());
+}
+
+static void putString(QByteArray& buffer, const QByteArray& text)
+{
+    put(buffer, (quint32)text.size());
+    buffer.append(text);
+}
+
+// A variant as it appears in the XML export
+static std::string variantText(const qpid::types::Variant& value)
+{
+    std::stringstream text;
+    text << value;
+    return text.str();
+}
+
+SnapshotWriter::SnapshotWriter(QIODevice* out) : QueueExporter(out), queueOffset(0)
+{
+}
+
+bool SnapshotWriter::isSnapshotFile(const QString& path)
+{
+    return QFileInfo(path).suffix().compare(SNAPSHOT_SUFFIX, Qt::CaseInsensitive) == 0;
+}
+
+// Write the record built up in record, and start the next one
+void SnapshotWriter::writeRecord(SnapshotRecordType type)
+{
+    char header[SNAPSHOT_RECORD_HEADER];
+    quint32 length = record.size();
+    header[0] = type;
+    memcpy(header + 1, &length, sizeof(length));
+    append(header, sizeof(header));
+    append(record.constData(), record.size());
+    record.clear();
+}
+
+void SnapshotWriter::beginQueue(const qmf::Data& queue)
+{
+    QByteArray start(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    put(start, SNAPSHOT_BYTE_ORDER);
+    append(start.constData(), start.size());
+
+    std::string name;
+    quint32 count = 0;
+    if (queue.isValid()) {
+        const qpid::types::Variant::Map& attrs(queue.getProperties());
+        qpid::types::Variant::Map::const_iterator iter = attrs.find("name");
+        if (iter != attrs.end()) {
+            name = iter->second.asString();
+            count = attrs.size() - 1;
+        } else {
+            count = attrs.size();
+        }
+    }
+    putString(record, name);
+    put(record, count);
+    if (queue.isValid()) {
+        const qpid::types::Variant::Map& attrs(queue.getProperties());
+        for (qpid::types::Variant::Map::const_iterator iter = attrs.begin(); iter != attrs.end(); iter++) {
+            if (iter->first != "name") {
+                putString(record, iter->first);
+                putString(record, variantText(iter->second));
+            }
+        }
+    }
+
+    queueOffset = bytesWritten();
+    writeRecord(SNAP_QUEUE);
+}
+
+// The header's arguments are flattened the same way as in the XML
+void SnapshotWriter::writeMessage(const std::string& messageId, const qmf::ConsoleEvent& header, const QString& body)
+{
+    putString(record, messageId);
+    putString(record, contentType(header));
+
+    QByteArray arguments;
+    quint32 count = 0;
+    const qpid::types::Variant::Map& args(header.getArguments());
+    for (qpid::types::Variant::Map::const_iterator iter = args.begin(); iter != args.end(); iter++) {
+        qpid::types::Variant::Map attrs = (iter->second).asMap();
+        for (qpid::types::Variant::Map::const_iterator attr = attrs.begin(); attr != attrs.end(); attr++) {
+            putString(arguments, attr->first);
+            putString(arguments, variantText(attr->second));
+            ++count;
+        }
+    }
+    put(record, count);
+    record.append(arguments);
+
+    headerOffsets.push_back(bytesWritten());
+    writeRecord(SNAP_HEADER);
+
+    putString(record, body.toUtf8());
+    writeRecord(SNAP_BODY);
+}
+
+void SnapshotWriter::endQueue()
+{
+    quint64 indexOffset = bytesWritten();
+    put(record, queueOffset);
+    put(record, (quint64)headerOffsets.size());
+    record.append(reinterpret_cast<const char*>(headerOffsets.empty() ? 0 : &headerOffsets[0]),
+                  headerOffsets.size() * sizeof(quint64));
+    writeRecord(SNAP_INDEX);
+
+    QByteArray trailer;
+    put(trailer, indexOffset);
+    trailer.append(SNAPSHOT_END, sizeof(SNAPSHOT_END));
+    append(trailer.constData(), trailer.size());
+    flush();
+}
@@ -0,0 +1,92 @@
+#ifndef _qe_snapshot_writer_h
+#define _qe_snapshot_writer_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#include <QByteArray>
+#include <vector>
+#include "queue-exporter.h"
+
+//
+// The binary queue snapshot. It starts with a header:
+//
+//   8 bytes  SNAPSHOT_MAGIC
+//   quint32  SNAPSHOT_BYTE_ORDER, written natively
+//
+// followed by records, each a type byte, a quint32 payload length and the
+// payload:
+//
+//   SNAP_QUEUE   name, quint32 count, count property name/value pairs
+//   SNAP_HEADER  message id, content type, quint32 count, count
+//                argument name/value pairs
+//   SNAP_BODY    body text
+//   SNAP_INDEX   quint64 offset of SNAP_QUEUE, quint64 count, count
+//                quint64 offsets of the SNAP_HEADER records
+//
+// and ends with a trailer:
+//
+//   quint64  offset of SNAP_INDEX
+//   8 bytes  SNAPSHOT_END
+//
+// Strings are a quint32 length and UTF-8. Each message is a SNAP_HEADER
+// followed straight away by its SNAP_BODY, so the index only needs the
+// header's offset, and a message can be found without reading the ones
+// before it.
+//
+extern const char SNAPSHOT_MAGIC[8];
+extern const char SNAPSHOT_END[8];
+const quint32 SNAPSHOT_BYTE_ORDER = 0x01020304;
+// exports to files with this suffix are written as snapshots
+extern const char SNAPSHOT_SUFFIX[];
+
+typedef enum {
+    SNAP_QUEUE = 'Q',
+    SNAP_HEADER = 'H',
+    SNAP_BODY = 'B',
+    SNAP_INDEX = 'X'
+} SnapshotRecordType;
+
+// size of a record's type and length
+const qint64 SNAPSHOT_RECORD_HEADER = 1 + sizeof(quint32);
+
+//
+// Writes a snapshot as the export goes. The index is the only thing
+// kept, 8 bytes per message, and is written at the end.
+//
+class SnapshotWriter : public QueueExporter {
+public:
+    SnapshotWriter(QIODevice* out);
+
+    void beginQueue(const qmf::Data& queue);
+    void writeMessage(const std::string& messageId, const qmf::ConsoleEvent& header, const QString& body);
+    void endQueue();
+
+    static bool isSnapshotFile(const QString& path);
+
+private:
+    QByteArray              record;
+    quint64                 queueOffset;
+    std::vector<quint64>    headerOffsets;
+
+    void writeRecord(SnapshotRecordType);
+};
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "sparkline-delegate.h"
+#include "model-queue.h"
+#include <QPainter>
+#include <QPolygonF>
+
+SparklineDelegate::SparklineDelegate(QObject* parent) : QStyledItemDelegate(parent)
+{
+}
+
+void SparklineDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    QStyledItemDelegate::paint(painter, option, index);
+
+    QVariantList points = index.data(QueueTableModel::SparklineRole).toList();
+    if (points.size() < 2)
+        return;
+
+    qulonglong low = points[0].toULongLong();
+    qulonglong high = low;
+    for (int idx=1; idx<points.size(); idx++) {
+        qulonglong value = points[idx].toULongLong();
+        low = qMin(low, value);
+        high = qMax(high, value);
+    }
+
+    // a flat line sits at the bottom of the cell
+    QRectF area = QRectF(option.rect).adjusted(2, 3, -2, -3);
+    double range = high > low ? (double)(high - low) : 1.0;
+    double step = area.width() / (points.size() - 1);
+
+    QPolygonF line;
+    for (int idx=0; idx<points.size(); idx++) {
+        double value = (double)(points[idx].toULongLong() - low);
+        line << QPointF(area.left() + idx * step, area.bottom() - value / range * area.height());
+    }
+
+    QColor color = option.palette.color(option.state & QStyle::State_Selected ?
+                                        QPalette::HighlightedText : QPalette::Highlight);
+    color.setAlpha(96);
+
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+    painter->setPen(QPen(color, 1.5));
+    painter->drawPolyline(line);
+    painter->restore();
+}
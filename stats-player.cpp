@@ -0,0 +1,245 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "stats-player.h"
+#include "stats-recorder.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    struct EntryBefore {
+        template <class E>
+        bool operator()(qint64 time, const E& entry) const { return time < entry.time; }
+    };
+}
+
+StatsPlayer::StatsPlayer() : data(0), size(0), properties(0), next(0)
+{
+}
+
+StatsPlayer::~StatsPlayer()
+{
+    close();
+}
+
+bool StatsPlayer::open(const QString& path)
+{
+    close();
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+    size = file.size();
+    data = size > 0 ? file.map(0, size) : 0;
+    if (!data) {
+        error = size > 0 ? file.errorString() : QString("The file is empty");
+        file.close();
+        return false;
+    }
+
+    if (!scan()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void StatsPlayer::close()
+{
+    if (data)
+        file.unmap(const_cast<uchar*>(data));
+    file.close();
+    data = 0;
+    size = 0;
+    names.clear();
+    entries.clear();
+    keyframes.clear();
+    state.clear();
+    next = 0;
+}
+
+qint64 StatsPlayer::startTime() const
+{
+    return entries.isEmpty() ? 0 : entries.first().time;
+}
+
+qint64 StatsPlayer::endTime() const
+{
+    return entries.isEmpty() ? 0 : entries.last().time;
+}
+
+template <class T>
+bool StatsPlayer::read(qint64& offset, T& value) const
+{
+    if (offset + (qint64)sizeof(T) > size)
+        return false;
+    memcpy(&value, data + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+// Index the file. A record cut short at the end, from a recording that
+// is still going or was interrupted, ends the scan.
+bool StatsPlayer::scan()
+{
+    qint64 offset = sizeof(RECORDING_MAGIC);
+    quint32 order;
+    quint32 count;
+    if (size < offset || memcmp(data, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0 ||
+        !read(offset, order) || order != RECORDING_BYTE_ORDER || !read(offset, count)) {
+        error = QString("Not a statistics recording from this kind of machine");
+        return false;
+    }
+    if (count > (quint32)QP_FIRST_DERIVED) {
+        error = QString("The recording is from a newer version");
+        return false;
+    }
+    properties = count;
+
+    for (;;) {
+        Entry entry;
+        entry.offset = offset;
+        quint8 type;
+        if (!read(offset, type))
+            break;
+        entry.type = type;
+
+        if (type == REC_NAME) {
+            quint32 id;
+            quint16 length;
+            if (!read(offset, id) || !read(offset, length) || offset + length > size)
+                break;
+            if ((int)id >= names.size())
+                names.resize(id + 1);
+            names[id] = QString::fromUtf8((const char*)data + offset, length);
+            offset += length;
+            continue;
+        }
+
+        if (!read(offset, entry.time) || !read(offset, count))
+            break;
+        if (type == REC_REMOVED) {
+            offset += (qint64)count * sizeof(quint32);
+            if (offset > size)
+                break;
+        } else if (type == REC_LIST || type == REC_UPDATE || type == REC_KEYFRAME) {
+            if (!skipSamples(offset, count))
+                break;
+        } else {
+            error = QString("The recording is damaged");
+            return false;
+        }
+
+        if (type == REC_KEYFRAME)
+            keyframes.append(entries.size());
+        entries.append(entry);
+    }
+
+    if (entries.isEmpty()) {
+        error = QString("The recording has no statistics in it");
+        return false;
+    }
+    return true;
+}
+
+bool StatsPlayer::skipSamples(qint64& offset, quint32 count) const
+{
+    for (quint32 idx = 0; idx < count; idx++) {
+        quint32 id;
+        quint32 present;
+        if (!read(offset, id) || !read(offset, present))
+            return false;
+        for (int p = QP_NAME + 1; p < properties; p++)
+            if (present & (1 << p))
+                offset += sizeof(quint64);
+        if (offset > size)
+            return false;
+    }
+    return true;
+}
+
+// Apply one timed record to the replay state. The scan has already
+// checked that it is all there.
+void StatsPlayer::apply(const Entry& entry)
+{
+    qint64 offset = entry.offset + sizeof(quint8) + sizeof(qint64);
+    quint32 count;
+    read(offset, count);
+
+    if (entry.type == REC_REMOVED) {
+        for (quint32 idx = 0; idx < count; idx++) {
+            quint32 id;
+            read(offset, id);
+            state.remove(id);
+        }
+        return;
+    }
+
+    if (entry.type == REC_KEYFRAME)
+        state.clear();
+    for (quint32 idx = 0; idx < count; idx++) {
+        quint32 id;
+        quint32 present;
+        read(offset, id);
+        read(offset, present);
+        QueueState& queue(state[id]);
+        queue.present |= present;
+        for (int p = QP_NAME + 1; p < properties; p++)
+            if (present & (1 << p))
+                read(offset, queue.values[p]);
+    }
+}
+
+QueueSampleBatch StatsPlayer::queuesAt(qint64 time)
+{
+    std::vector<QueueSample>* queues = new std::vector<QueueSample>();
+    QueueSampleBatch batch(queues);
+
+    // the last record at or before time
+    int last = std::upper_bound(entries.begin(), entries.end(), time, EntryBefore()) - entries.begin() - 1;
+    if (last < 0)
+        return batch;
+
+    // the keyframe to start from, unless replaying on from here is shorter
+    int key = std::upper_bound(keyframes.begin(), keyframes.end(), last) - keyframes.begin() - 1;
+    int from = key < 0 ? 0 : keyframes[key];
+    if (next > last + 1 || next < from) {
+        state.clear();
+        next = from;
+    }
+    while (next <= last)
+        apply(entries[next++]);
+
+    queues->reserve(state.size());
+    for (QHash<quint32, QueueState>::const_iterator queue = state.begin(); queue != state.end(); queue++) {
+        QueueSample sample;
+        if ((int)queue.key() < names.size())
+            sample.name = names[queue.key()];
+        sample.objectName = sample.name;
+        sample.present = queue.value().present | (1 << QP_NAME);
+        for (int p = QP_NAME + 1; p < QP_COUNT; p++)
+            sample.values[p] = p < properties && (queue.value().present & (1 << p)) ? queue.value().values[p] : 0;
+        sample.time = time;
+        queues->push_back(sample);
+    }
+    return batch;
+}
@@ -0,0 +1,84 @@
+#ifndef _qe_stats_player_h
+#define _qe_stats_player_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <QFile>
+#include <QHash>
+#include <QVector>
+#include <QString>
+#include "queue-stats.h"
+
+//
+// Plays back a file written by StatsRecorder. The file is memory mapped
+// and scanned once to index the timed records and the keyframes. Asking
+// for the queues at some time replays the records from the nearest
+// keyframe before it, or carries on from the last position when moving
+// forward, so scrubbing through a long recording stays fast.
+//
+class StatsPlayer {
+public:
+    StatsPlayer();
+    ~StatsPlayer();
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return data != 0; }
+    QString errorString() const { return error; }
+
+    qint64 startTime() const;
+    qint64 endTime() const;
+
+    // every queue and its values as they were at time
+    QueueSampleBatch queuesAt(qint64 time);
+
+private:
+    struct Entry {
+        qint64  time;
+        qint64  offset;
+        char    type;
+    };
+
+    struct QueueState {
+        quint32 present;
+        quint64 values[QP_FIRST_DERIVED];
+    };
+
+    QFile           file;
+    const uchar*    data;
+    qint64          size;
+    QString         error;
+    int             properties;     // per sample in this file
+
+    QVector<QString>    names;      // by queue id
+    QVector<Entry>      entries;    // the timed records, in file order
+    QVector<int>        keyframes;  // entries that are keyframes
+
+    // replay position
+    QHash<quint32, QueueState>  state;
+    int                         next;   // the next entry to apply
+
+    bool scan();
+    bool skipSamples(qint64& offset, quint32 count) const;
+    void apply(const Entry&);
+    template <class T> bool read(qint64& offset, T& value) const;
+};
+
+#endif
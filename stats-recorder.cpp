@@ -0,0 +1,256 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "stats-recorder.h"
+#include <QDateTime>
+#include <QMutexLocker>
+
+const char RECORDING_MAGIC[8] = { 'Q', 'V', 'S', 'T', 'A', 'T', 'S', '1' };
+
+// the properties a recorded sample can carry
+static const quint32 RECORDED_MASK = ((1 << QP_FIRST_DERIVED) - 1) & ~(1 << QP_NAME);
+
+// the most batches waiting for the disk before new ones are dropped
+static const int MAX_PENDING = 1000;
+// msecs between keyframes
+static const qint64 KEYFRAME_INTERVAL = 60000;
+
+template <class T>
+static void put(QByteArray& buffer, const T& value)
+{
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+StatsRecorder::StatsRecorder(QObject* parent) :
+    QThread(parent), stopping(false), dropped(0), lastKeyframe(0)
+{
+}
+
+StatsRecorder::~StatsRecorder()
+{
+    stop();
+}
+
+bool StatsRecorder::record(const QString& path)
+{
+    stop();
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    ids.clear();
+    state.clear();
+    lastKeyframe = 0;
+    dropped = 0;
+    stopping = false;
+
+    buffer.clear();
+    buffer.append(RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    put(buffer, RECORDING_BYTE_ORDER);
+    put(buffer, (quint32)QP_FIRST_DERIVED);
+    file.write(buffer);
+
+    start(QThread::LowPriority);
+    return true;
+}
+
+// Whatever is still waiting is written before the file is closed
+void StatsRecorder::stop()
+{
+    if (!isRunning())
+        return;
+    {
+        QMutexLocker locker(&lock);
+        stopping = true;
+        wake.wakeOne();
+    }
+    wait();
+}
+
+void StatsRecorder::queuesListed(const QueueSampleBatch& batch, uint correlator)
+{
+    queue(REC_LIST, batch, correlator);
+}
+
+void StatsRecorder::queuesUpdated(const QueueSampleBatch& batch)
+{
+    queue(REC_UPDATE, batch, 0);
+}
+
+void StatsRecorder::queueListDone(uint correlator)
+{
+    queue(REC_REMOVED, QueueSampleBatch(), correlator);
+}
+
+// Runs on the QMF thread, so it only queues the batch. If the disk can't
+// keep up the batch is dropped rather than holding up the refresh.
+void StatsRecorder::queue(RecordType type, const QueueSampleBatch& batch, uint correlator)
+{
+    if (!isRunning())
+        return;
+
+    Pending item;
+    item.type = type;
+    item.batch = batch;
+    item.correlator = correlator;
+    item.time = QDateTime::currentMSecsSinceEpoch();
+
+    QMutexLocker locker(&lock);
+    if (stopping)
+        return;
+    if (pending.size() >= MAX_PENDING) {
+        ++dropped;
+        return;
+    }
+    pending.append(item);
+    wake.wakeOne();
+}
+
+void StatsRecorder::run()
+{
+    for (;;) {
+        QList<Pending> work;
+        {
+            QMutexLocker locker(&lock);
+            while (pending.isEmpty() && !stopping)
+                wake.wait(&lock);
+            if (pending.isEmpty())
+                break;
+            work = pending;
+            pending.clear();
+        }
+
+        buffer.clear();
+        for (QList<Pending>::const_iterator item = work.begin(); item != work.end(); item++) {
+            if (item->type == REC_REMOVED)
+                encodeRemoved(*item);
+            else
+                encode(*item);
+            if (item->time - lastKeyframe >= KEYFRAME_INTERVAL)
+                encodeKeyframe(item->time);
+        }
+        file.write(buffer);
+        file.flush();
+    }
+    file.close();
+}
+
+// A queue seen for the first time gets its name record ahead of the
+// batch. Queues are known by their QMF object name, like in the queue
+// table, since pushed updates may not carry the queue name. Updates for
+// queues that haven't been listed yet are skipped, the queue table
+// ignores them too.
+void StatsRecorder::encode(const Pending& item)
+{
+    std::vector<const QueueSample*> kept;
+    std::vector<quint32> keptIds;
+
+    for (std::vector<QueueSample>::const_iterator sample = item.batch->begin();
+         sample != item.batch->end(); sample++) {
+        quint32 id;
+        if (item.type == REC_LIST) {
+            id = idOf(*sample);
+            state[id].correlator = item.correlator;
+        } else {
+            QHash<QString, quint32>::const_iterator found = ids.find(sample->objectName);
+            if (found == ids.end() || !state.contains(found.value()))
+                continue;
+            id = found.value();
+        }
+
+        QueueState& queue(state[id]);
+        queue.present |= sample->present & RECORDED_MASK;
+        for (int p = QP_NAME + 1; p < QP_FIRST_DERIVED; p++)
+            if (sample->has((QueueProperty)p))
+                queue.values[p] = sample->values[p];
+        kept.push_back(&*sample);
+        keptIds.push_back(id);
+    }
+    if (kept.empty())
+        return;
+
+    put(buffer, (quint8)item.type);
+    put(buffer, item.time);
+    put(buffer, (quint32)kept.size());
+    for (size_t idx = 0; idx < kept.size(); idx++)
+        putSample(keptIds[idx], kept[idx]->present & RECORDED_MASK, kept[idx]->values);
+}
+
+// The queues that were not in the list that just finished are gone, the
+// same way QueueTableModel::refresh() drops them
+void StatsRecorder::encodeRemoved(const Pending& item)
+{
+    QList<quint32> removed;
+    for (QHash<quint32, QueueState>::iterator queue = state.begin(); queue != state.end(); ) {
+        if (queue.value().correlator != item.correlator) {
+            removed.append(queue.key());
+            queue = state.erase(queue);
+        } else {
+            ++queue;
+        }
+    }
+    if (removed.isEmpty())
+        return;
+
+    put(buffer, (quint8)REC_REMOVED);
+    put(buffer, item.time);
+    put(buffer, (quint32)removed.size());
+    for (QList<quint32>::const_iterator id = removed.begin(); id != removed.end(); id++)
+        put(buffer, *id);
+}
+
+void StatsRecorder::encodeKeyframe(qint64 time)
+{
+    put(buffer, (quint8)REC_KEYFRAME);
+    put(buffer, time);
+    put(buffer, (quint32)state.size());
+    for (QHash<quint32, QueueState>::const_iterator queue = state.begin(); queue != state.end(); queue++)
+        putSample(queue.key(), queue.value().present, queue.value().values);
+    lastKeyframe = time;
+}
+
+// Name records go straight into the buffer. They hold the name shown in
+// the queue table.
+quint32 StatsRecorder::idOf(const QueueSample& sample)
+{
+    QHash<QString, quint32>::const_iterator found = ids.find(sample.objectName);
+    if (found != ids.end())
+        return found.value();
+
+    quint32 id = ids.size();
+    ids.insert(sample.objectName, id);
+
+    QByteArray utf8 = sample.name.toUtf8();
+    put(buffer, (quint8)REC_NAME);
+    put(buffer, id);
+    put(buffer, (quint16)utf8.size());
+    buffer.append(utf8);
+    return id;
+}
+
+void StatsRecorder::putSample(quint32 id, quint32 present, const quint64* values)
+{
+    put(buffer, id);
+    put(buffer, present);
+    for (int p = QP_NAME + 1; p < QP_FIRST_DERIVED; p++)
+        if (present & (1 << p))
+            put(buffer, values[p]);
+}
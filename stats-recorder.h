@@ -0,0 +1,126 @@
+#ifndef _qe_stats_recorder_h
+#define _qe_stats_recorder_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+#include "queue-stats.h"
+
+//
+// The statistics recording file. It starts with a header:
+//
+//   8 bytes  RECORDING_MAGIC
+//   quint32  RECORDING_BYTE_ORDER, written natively
+//   quint32  number of queue properties in each sample
+//
+// followed by records, each starting with its type byte:
+//
+//   REC_NAME      quint32 id, quint16 length, UTF-8 queue name
+//   REC_LIST      qint64 time, quint32 count, count samples
+//   REC_UPDATE    qint64 time, quint32 count, count samples
+//   REC_KEYFRAME  qint64 time, quint32 count, count samples
+//   REC_REMOVED   qint64 time, quint32 count, count queue ids
+//
+// A sample is a quint32 queue id, a quint32 present mask and a quint64
+// for each present property. Times are msecs since the epoch. A keyframe
+// holds every queue with all of its values, so playback can start there.
+//
+extern const char RECORDING_MAGIC[8];
+const quint32 RECORDING_BYTE_ORDER = 0x01020304;
+
+typedef enum {
+    REC_NAME = 'N',
+    REC_LIST = 'L',
+    REC_UPDATE = 'U',
+    REC_KEYFRAME = 'K',
+    REC_REMOVED = 'R'
+} RecordType;
+
+//
+// Appends every queue statistics batch to a recording file. The batches
+// are handed over from the QMF thread, which only has to queue a shared
+// pointer; encoding and writing happen on the recorder's own thread.
+//
+class StatsRecorder : public QThread {
+    Q_OBJECT
+
+public:
+    StatsRecorder(QObject* parent = 0);
+    ~StatsRecorder();
+
+    // start recording into a new file
+    bool record(const QString& path);
+    void stop();
+    bool isRecording() const { return isRunning(); }
+    QString errorString() const { return file.errorString(); }
+    uint droppedBatches() const { return dropped; }
+
+public slots:
+    // these are called directly from the QMF thread
+    void queuesListed(const QueueSampleBatch&, uint correlator);
+    void queuesUpdated(const QueueSampleBatch&);
+    void queueListDone(uint correlator);
+
+protected:
+    void run();
+
+private:
+    struct Pending {
+        RecordType          type;
+        QueueSampleBatch    batch;
+        uint                correlator;
+        qint64              time;
+    };
+
+    // the last values written for a queue, for keyframes
+    struct QueueState {
+        quint32 present;
+        quint64 values[QP_FIRST_DERIVED];
+        uint    correlator;
+    };
+
+    QMutex          lock;
+    QWaitCondition  wake;
+    QList<Pending>  pending;
+    bool            stopping;
+    uint            dropped;
+
+    // only used by the recorder thread
+    QFile                       file;
+    QByteArray                  buffer;
+    QHash<QString, quint32>     ids;    // by QMF object name
+    QHash<quint32, QueueState>  state;
+    qint64                      lastKeyframe;
+
+    void queue(RecordType, const QueueSampleBatch&, uint correlator);
+    void encode(const Pending&);
+    void encodeRemoved(const Pending&);
+    void encodeKeyframe(qint64 time);
+    quint32 idOf(const QueueSample&);
+    void putSample(quint32 id, quint32 present, const quint64* values);
+};
+
+#endif
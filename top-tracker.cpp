@@ -0,0 +1,200 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "top-tracker.h"
+#include "row-runs.h"
+
+TopTracker::TopTracker() : count(0)
+{
+}
+
+void TopTracker::setLimit(int limit)
+{
+    count = limit < 0 ? 0 : limit;
+    balance();
+}
+
+// Rebuild both heaps. The rest heap is built bottom up in O(n), then the
+// top is filled from it.
+void TopTracker::load(const std::vector<quint64>& newKeys)
+{
+    keys = newKeys;
+    int rows = (int)keys.size();
+
+    inTop.assign(rows, 0);
+    position.resize(rows);
+    top.clear();
+    rest.resize(rows);
+    for (int row = 0; row < rows; row++)
+        place(rest, row, row);
+    for (int pos = rows / 2 - 1; pos >= 0; pos--)
+        siftDown(false, pos);
+
+    balance();
+    changed.clear();
+}
+
+void TopTracker::clear()
+{
+    keys.clear();
+    inTop.clear();
+    position.clear();
+    top.clear();
+    rest.clear();
+    changed.clear();
+}
+
+void TopTracker::insert(int row, quint64 key)
+{
+    Q_ASSERT(row == size());
+    keys.push_back(key);
+    inTop.push_back(0);
+    position.push_back(0);
+    push(false, row);
+    balance();
+}
+
+void TopTracker::update(int row, quint64 key)
+{
+    if (keys[row] == key)
+        return;
+    keys[row] = key;
+    fix(inTop[row] != 0, position[row]);
+    balance();
+}
+
+// The heaps are rebuilt for the renumbered rows, and the rows whose
+// membership differs from before are reported as changed. Changes not
+// yet taken are dropped since their row numbers are no longer valid.
+void TopTracker::removeFlagged(const QVector<bool>& flagged, const std::vector<quint64>& newKeys)
+{
+    std::vector<char> was(inTop);
+    eraseFlagged(was, flagged);
+
+    load(newKeys);
+    for (int row = 0; row < size() && row < (int)was.size(); row++)
+        if (was[row] != inTop[row])
+            changed.push_back(row);
+}
+
+void TopTracker::takeChanged(std::vector<int>& rows)
+{
+    rows.clear();
+    rows.swap(changed);
+}
+
+// Should row a be nearer the root than row b
+bool TopTracker::above(bool minHeap, int a, int b) const
+{
+    return minHeap ? keys[a] < keys[b] : keys[a] > keys[b];
+}
+
+void TopTracker::place(std::vector<int>& heap, int pos, int row)
+{
+    heap[pos] = row;
+    position[row] = pos;
+}
+
+void TopTracker::siftUp(bool minHeap, int pos)
+{
+    std::vector<int>& heap(minHeap ? top : rest);
+    int row = heap[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!above(minHeap, row, heap[parent]))
+            break;
+        place(heap, pos, heap[parent]);
+        pos = parent;
+    }
+    place(heap, pos, row);
+}
+
+void TopTracker::siftDown(bool minHeap, int pos)
+{
+    std::vector<int>& heap(minHeap ? top : rest);
+    int size = (int)heap.size();
+    int row = heap[pos];
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= size)
+            break;
+        if (child + 1 < size && above(minHeap, heap[child + 1], heap[child]))
+            ++child;
+        if (!above(minHeap, heap[child], row))
+            break;
+        place(heap, pos, heap[child]);
+        pos = child;
+    }
+    place(heap, pos, row);
+}
+
+// Restore the heap after the key of the row at pos changed
+void TopTracker::fix(bool minHeap, int pos)
+{
+    int row = (minHeap ? top : rest)[pos];
+    siftUp(minHeap, pos);
+    siftDown(minHeap, position[row]);
+}
+
+void TopTracker::push(bool minHeap, int row)
+{
+    std::vector<int>& heap(minHeap ? top : rest);
+    heap.push_back(row);
+    inTop[row] = minHeap;
+    position[row] = (int)heap.size() - 1;
+    siftUp(minHeap, position[row]);
+}
+
+int TopTracker::pop(bool minHeap)
+{
+    std::vector<int>& heap(minHeap ? top : rest);
+    int row = heap[0];
+    int last = heap.back();
+    heap.pop_back();
+    if (!heap.empty()) {
+        place(heap, 0, last);
+        siftDown(minHeap, 0);
+    }
+    return row;
+}
+
+// Move rows between the heaps until the top holds the count largest keys.
+// Equal keys don't swap, so rows don't flicker in and out of the top.
+void TopTracker::balance()
+{
+    while ((int)top.size() > count) {
+        int row = pop(true);
+        push(false, row);
+        changed.push_back(row);
+    }
+    while ((int)top.size() < count && !rest.empty()) {
+        int row = pop(false);
+        push(true, row);
+        changed.push_back(row);
+    }
+    while (!top.empty() && !rest.empty() && keys[rest[0]] > keys[top[0]]) {
+        int out = pop(true);
+        int in = pop(false);
+        push(true, in);
+        push(false, out);
+        changed.push_back(in);
+        changed.push_back(out);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef _qe_top_tracker_h
+#define _qe_top_tracker_h
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <QtGlobal>
+#include <QVector>
+#include <vector>
+
+//
+// Keeps track of which rows have the N largest keys. The rows are split
+// over two indexed heaps: a min-heap holding the top N, and a max-heap
+// holding everything else. Changing one key costs O(log n), and the row
+// that has to leave the top when another one enters is always at the
+// root of the top heap.
+//
+class TopTracker {
+public:
+    TopTracker();
+
+    void setLimit(int);
+    int limit() const { return count; }
+
+    // start over with a key for every row
+    void load(const std::vector<quint64>& keys);
+    void clear();
+
+    // append a row, which must be numbered size()
+    void insert(int row, quint64 key);
+    void update(int row, quint64 key);
+    // drop the flagged rows and renumber the rest, given the keys of the rows left
+    void removeFlagged(const QVector<bool>& flagged, const std::vector<quint64>& keys);
+
+    int size() const { return (int)keys.size(); }
+    bool contains(int row) const { return row < size() && inTop[row]; }
+
+    // the rows that went in or out of the top since the last call
+    void takeChanged(std::vector<int>& rows);
+
+private:
+    int count;
+
+    std::vector<quint64> keys;      // by row
+    std::vector<char>    inTop;     // by row, which heap the row is in
+    std::vector<int>     position;  // by row, where the row is in its heap
+    std::vector<int>     top;       // min-heap of rows
+    std::vector<int>     rest;      // max-heap of rows
+    std::vector<int>     changed;
+
+    bool above(bool minHeap, int a, int b) const;
+    void place(std::vector<int>& heap, int pos, int row);
+    void siftUp(bool minHeap, int pos);
+    void siftDown(bool minHeap, int pos);
+    void fix(bool minHeap, int pos);
+    void push(bool minHeap, int row);
+    int  pop(bool minHeap);
+    void balance();
+};
+
+#endif